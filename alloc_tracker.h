@@ -0,0 +1,36 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+// Heap allocation counter for the "no allocations in a steady-state frame"
+// checks. Building with -DICY_TRACK_ALLOCS replaces the global operator new;
+// include this header from exactly one translation unit per binary.
+class AllocTracker {
+public:
+#ifdef ICY_TRACK_ALLOCS
+    static inline std::atomic<std::uint64_t> allocations{0};
+
+    static bool enabled() { return true; }
+    static std::uint64_t count() { return allocations.load(std::memory_order_relaxed); }
+#else
+    static bool enabled() { return false; }
+    static std::uint64_t count() { return 0; }
+#endif
+};
+
+#ifdef ICY_TRACK_ALLOCS
+void* operator new(std::size_t size) {
+    AllocTracker::allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+#endif
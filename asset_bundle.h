@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// assets.bundle layout, written by pack_assets in native byte order:
+// BundleHeader, entryCount BundleEntry records, then 16-byte aligned payloads.
+// Images are stored as decoded RGBA8 pixels, everything else as raw bytes.
+const char BUNDLE_MAGIC[4] = {'I', 'C', 'Y', 'B'};
+const std::uint32_t BUNDLE_VERSION = 1;
+
+enum class BundleKind : std::uint32_t { Raw = 0, ImageRGBA = 1 };
+
+struct BundleHeader {
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t entryCount;
+    std::uint32_t reserved;
+};
+
+struct BundleEntry {
+    char name[48];
+    BundleKind kind;
+    std::uint32_t width;
+    std::uint32_t height;
+    std::uint32_t reserved;
+    std::uint64_t offset;
+    std::uint64_t size;
+};
+
+// Read-only view of a bundle file. The file is memory-mapped where possible so
+// payloads can be handed to the GPU or FreeType without an intermediate copy.
+class AssetBundle {
+public:
+    AssetBundle() = default;
+    AssetBundle(const AssetBundle&) = delete;
+    AssetBundle& operator=(const AssetBundle&) = delete;
+
+    ~AssetBundle() { close(); }
+
+    // Returns false when the file is missing or not a bundle of this version.
+    bool open(const std::string& path) {
+        close();
+#ifndef _WIN32
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* p = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                base = static_cast<const std::uint8_t*>(p);
+                length = static_cast<std::size_t>(st.st_size);
+                mapped = true;
+            }
+        }
+        ::close(fd);
+#endif
+        if (!base) {
+            std::ifstream file(path, std::ios::binary);
+            if (!file) return false;
+            fallback.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+            base = fallback.data();
+            length = fallback.size();
+        }
+        if (!valid()) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    bool isOpen() const { return base != nullptr; }
+
+    const BundleEntry* find(const std::string& name) const {
+        if (!base) return nullptr;
+        for (std::uint32_t i = 0; i < header().entryCount; i++) {
+            const BundleEntry& e = entries()[i];
+            if (name == e.name) return &e;
+        }
+        return nullptr;
+    }
+
+    const std::uint8_t* data(const BundleEntry& entry) const { return base + entry.offset; }
+
+private:
+    const std::uint8_t* base = nullptr;
+    std::size_t length = 0;
+    bool mapped = false;
+    std::vector<std::uint8_t> fallback;
+
+    const BundleHeader& header() const { return *reinterpret_cast<const BundleHeader*>(base); }
+    const BundleEntry* entries() const { return reinterpret_cast<const BundleEntry*>(base + sizeof(BundleHeader)); }
+
+    bool valid() const {
+        if (length < sizeof(BundleHeader)) return false;
+        if (std::memcmp(header().magic, BUNDLE_MAGIC, 4) != 0 || header().version != BUNDLE_VERSION) return false;
+        std::uint64_t table = sizeof(BundleHeader) + std::uint64_t(header().entryCount) * sizeof(BundleEntry);
+        if (table > length) return false;
+        for (std::uint32_t i = 0; i < header().entryCount; i++) {
+            const BundleEntry& e = entries()[i];
+            if (e.offset > length || e.size > length - e.offset) return false;
+            if (e.name[sizeof(e.name) - 1] != '\0') return false;
+            if (e.kind == BundleKind::ImageRGBA && std::uint64_t(e.width) * e.height * 4 != e.size) return false;
+        }
+        return true;
+    }
+
+    void close() {
+#ifndef _WIN32
+        if (mapped) munmap(const_cast<std::uint8_t*>(base), length);
+#endif
+        base = nullptr;
+        length = 0;
+        mapped = false;
+        fallback.clear();
+    }
+};
@@ -0,0 +1,135 @@
+#include "sim.h"
+#include "particles.h"
+#include "vec_env.h"
+#include "bench.h"
+
+// Headless microbenchmarks for the simulation hot paths at the shipped size
+// and at stress sizes. Run with make bench.
+
+static Simulation makeSim(int platformCount) {
+    SimParams params;
+    params.platformCount = platformCount;
+    Simulation sim(params);
+    sim.reset(42);
+    return sim;
+}
+
+static void benchPlayerUpdate(BenchRunner& bench) {
+    Simulation sim = makeSim(PLATFORM_COUNT);
+    sim.player.vel = {PLAYER_MAX_SPEED, JUMP_FORCE};
+    const PlayerState start = sim.player;
+    bench.run("player_update", 1, [&](std::uint64_t n) {
+        for (std::uint64_t i = 0; i < n; i++) {
+            sim.player = start;
+            sim.updatePlayer(1.0f / TICK_RATE);
+            sim.handleWallCollision();
+            benchKeep(sim.player.pos.y);
+        }
+    });
+}
+
+// The player is falling onto a platform halfway up the tower, so every call
+// does the broadphase search and the narrow test.
+static void benchCollisions(BenchRunner& bench, int platformCount) {
+    Simulation sim = makeSim(platformCount);
+    const PlatformState& target = sim.platformAt(platformCount / 2);
+    sim.player.pos = {target.pos.x, target.pos.y - PLAYER_SIZE + 5};
+    sim.player.vel = {0, 5};
+    const PlayerState start = sim.player;
+    const Vec2 from = {start.pos.x, start.pos.y - 5};
+    bench.run("handle_collisions", platformCount, [&](std::uint64_t n) {
+        for (std::uint64_t i = 0; i < n; i++) {
+            sim.player = start;
+            sim.handleCollisions(from, start.vel.y, 1.0f / TICK_RATE);
+            benchKeep(sim.player.pos.y);
+        }
+    });
+}
+
+// The player climbs steadily so the camera keeps scrolling and recycling.
+static void benchCamera(BenchRunner& bench, int platformCount) {
+    Simulation sim = makeSim(platformCount);
+    bench.run("update_camera", platformCount, [&](std::uint64_t n) {
+        for (std::uint64_t i = 0; i < n; i++) {
+            float fromY = sim.player.pos.y;
+            sim.player.pos.y -= 5;
+            sim.updateCamera(1.0f / TICK_RATE, fromY);
+            benchKeep(sim.cameraY);
+        }
+    });
+}
+
+// Every platform but the ground moves, so one op is the movers' loop over
+// the whole tower.
+static void benchMovingPlatforms(BenchRunner& bench, int platformCount) {
+    SimParams params;
+    params.platformCount = platformCount;
+    params.platformKindCount = 2;
+    params.platformKinds[0].weight = 0;
+    params.platformKinds[1].moveSpeed = 1.2f;
+    params.platformKinds[1].moveRange = 90;
+    Simulation sim(params);
+    sim.reset(42);
+    bench.run("update_platforms", platformCount, [&](std::uint64_t n) {
+        for (std::uint64_t i = 0; i < n; i++) {
+            sim.updatePlatforms(1.0f / TICK_RATE);
+            benchKeep(sim.platforms[1].pos.x);
+        }
+    });
+}
+
+static void benchStep(BenchRunner& bench, int platformCount) {
+    Simulation sim = makeSim(platformCount);
+    std::uint64_t seed = 1;
+    bench.run("simulation_step", platformCount, [&](std::uint64_t n) {
+        for (std::uint64_t i = 0; i < n; i++) {
+            std::uint8_t input = (i & 64) ? INPUT_RIGHT : INPUT_LEFT;
+            if ((i & 31) == 0) input |= INPUT_JUMP;
+            sim.step(input, 1.0f / TICK_RATE);
+            if (sim.gameOver) sim.reset(seed++);
+            benchKeep(sim.player.pos.y);
+        }
+    });
+}
+
+// One op is a whole-pool update; expired particles are re-emitted so the
+// population stays at the requested size.
+static void benchParticles(BenchRunner& bench, int count) {
+    ParticlePool pool(count, 7);
+    bench.run("particle_update", count, [&](std::uint64_t n) {
+        for (std::uint64_t i = 0; i < n; i++) {
+            if (pool.count < count) pool.emit(200, 300, 3.0f, count - pool.count);
+            pool.update(1.0f / TICK_RATE);
+            benchKeep(pool.count ? pool.x[0] : 0.0f);
+        }
+    });
+}
+
+// One op is one game stepped: a VecEnv step over all games, divided out.
+static void benchVecEnv(BenchRunner& bench, int games) {
+    VecEnv env(games);
+    env.reset(1);
+    Rng rng(3);
+    std::vector<std::uint8_t> actions(games);
+    bench.run("vec_env_step", games, [&](std::uint64_t n) {
+        for (std::uint64_t i = 0; i < n; i += games) {
+            for (auto& a : actions) a = static_cast<std::uint8_t>(rng.next() & 7);
+            env.step(actions.data());
+            benchKeep(env.observations()[0]);
+        }
+    });
+}
+
+int main(int argc, char** argv) {
+    BenchRunner bench("sim", argc, argv);
+    benchPlayerUpdate(bench);
+    for (int platforms : {PLATFORM_COUNT, 1000}) {
+        benchCollisions(bench, platforms);
+        benchCamera(bench, platforms);
+        benchMovingPlatforms(bench, platforms);
+        benchStep(bench, platforms);
+    }
+    for (int particles : {50, 50000}) benchParticles(bench, particles);
+    for (int games : {64, 4096}) benchVecEnv(bench, games);
+    return bench.finish();
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Minimal benchmark harness shared by the bench binaries. Each case is
+// calibrated to a fixed time slice, sampled several times and reported as
+// the median ns per operation. --json=FILE appends one JSON object per case
+// (tagged with --tag, e.g. the commit) so runs can be diffed across commits.
+struct BenchResult {
+    std::string name;
+    int size;
+    double nsPerOp;
+    std::uint64_t ops;
+};
+
+// Stops the optimiser from deleting the work being measured.
+inline volatile float benchSink;
+inline void benchKeep(float value) { benchSink = value; }
+
+class BenchRunner {
+public:
+    BenchRunner(const char* suite, int argc, char** argv) : suite(suite) {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg.rfind("--json=", 0) == 0) jsonPath = arg.substr(7);
+            else if (arg.rfind("--tag=", 0) == 0) tag = arg.substr(6);
+            else if (arg.rfind("--filter=", 0) == 0) filter = arg.substr(9);
+            else if (arg == "--quick") sliceSeconds = 0.01;
+            else extraArgs.push_back(arg);
+        }
+    }
+
+    // Arguments the harness did not recognise, for suite-specific options.
+    std::vector<std::string> extraArgs;
+
+    bool wants(const std::string& name) const {
+        return filter.empty() || name.find(filter) != std::string::npos;
+    }
+
+    // body(n) must perform n operations.
+    template <typename F>
+    void run(const std::string& name, int size, F&& body) {
+        if (!wants(name)) return;
+        std::uint64_t iterations = 1;
+        while (time(body, iterations) < sliceSeconds / 4 && iterations < (1ull << 40)) iterations *= 2;
+        double perSlice = time(body, iterations);
+        iterations = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(iterations * sliceSeconds / std::max(perSlice, 1e-9)));
+
+        std::vector<double> samples;
+        for (int s = 0; s < 5; s++) samples.push_back(time(body, iterations) * 1e9 / iterations);
+        std::sort(samples.begin(), samples.end());
+        record({name, size, samples[samples.size() / 2], iterations * 5});
+    }
+
+    // For cases that time themselves (e.g. a fixed number of rendered frames).
+    void record(const BenchResult& result) {
+        results.push_back(result);
+        char line[160];
+        std::snprintf(line, sizeof(line), "%-28s %8d %14.1f ns/op %12.0f ops/s", result.name.c_str(), result.size,
+                      result.nsPerOp, 1e9 / result.nsPerOp);
+        std::cout << line << std::endl;
+    }
+
+    int finish() {
+        if (jsonPath.empty()) return 0;
+        std::ofstream out(jsonPath, std::ios::app);
+        for (const auto& r : results) {
+            char line[320];
+            std::snprintf(line, sizeof(line),
+                          "{\"suite\":\"%s\",\"tag\":\"%s\",\"bench\":\"%s\",\"size\":%d,\"ns_per_op\":%.3f,\"ops\":%llu}\n",
+                          suite, tag.c_str(), r.name.c_str(), r.size, r.nsPerOp,
+                          static_cast<unsigned long long>(r.ops));
+            out << line;
+        }
+        if (!out) {
+            std::cerr << "Failed to write " << jsonPath << "." << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+private:
+    const char* suite;
+    std::string jsonPath;
+    std::string tag;
+    std::string filter;
+    double sliceSeconds = 0.05;
+    std::vector<BenchResult> results;
+
+    template <typename F>
+    static double time(F& body, std::uint64_t iterations) {
+        auto start = std::chrono::steady_clock::now();
+        body(iterations);
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+};
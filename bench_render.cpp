@@ -0,0 +1,169 @@
+#include <SFML/Graphics.hpp>
+#include <SFML/OpenGL.hpp>
+#include "render.h"
+#include "upscale.h"
+#include "bench.h"
+#include <string>
+
+// Renders full game frames offscreen into the game's screen texture: the
+// simulation steps with scripted input, then background, platforms,
+// particles, player and HUD are drawn as in Game::run. frame_render_share
+// draws at three times the logical resolution with the share of it that
+// dynamic resolution would use, in percent. Every frame ends with
+// glFinish so the time includes the GPU work. make bench runs it with
+// software GL (under xvfb-run when there is no display) so numbers are
+// comparable between machines without a GPU.
+// Extra options: --frames=N per case (default 300); --check runs the
+// renderer checks instead of timing and fails if one does not hold.
+
+static void renderFrames(BenchRunner& bench, TextureManager& textures, UpscaledTarget& screen,
+                         const std::string& name, int size, int platformCount, int particleCount, int frames) {
+    if (!bench.wants(name)) return;
+    sf::RenderTarget& target = screen.target();
+    SimParams params;
+    params.platformCount = platformCount;
+    Simulation sim(params);
+    sim.reset(42);
+
+    PlatformRenderer platformRenderer(textures.platformTexture);
+    ParticlePool particles(particleCount, 7);
+    ParticleRenderer particleRenderer;
+    Player player;
+    player.setTexture(textures.playerTexture);
+
+    BackgroundRenderer background;
+    background.setThemes(textures.backgroundTextures);
+    background.setTheme(0, true);
+    sf::Text scoreText("Score: 0", textures.font, 20);
+    scoreText.setPosition(10, 10);
+
+    sf::View worldView(sf::FloatRect(0, 0, WIDTH, HEIGHT));
+    sf::View hudView(sf::FloatRect(0, 0, WIDTH, HEIGHT));
+    screen.fit(worldView);
+    screen.fit(hudView);
+    char scoreBuffer[32];
+    std::vector<double> frameNs;
+    frameNs.reserve(frames);
+
+    for (int frame = 0; frame < frames; frame++) {
+        sf::Clock clock;
+        std::uint8_t input = (frame & 64) ? INPUT_RIGHT : INPUT_LEFT;
+        if ((frame & 31) == 0) input |= INPUT_JUMP;
+        sim.step(input, 1.0f / TICK_RATE);
+        if (sim.gameOver) {
+            sim.reset(42 + frame);
+            platformRenderer.invalidate();
+        }
+
+        if (particles.count < particleCount) {
+            particles.emit(sim.player.pos.x, sim.player.pos.y + PLAYER_SIZE, 3.0f, particleCount - particles.count);
+        }
+        particles.update(1.0f / TICK_RATE);
+        particleRenderer.build(particles);
+        platformRenderer.build(sim.platforms);
+        player.sync(sim.player);
+        std::snprintf(scoreBuffer, sizeof(scoreBuffer), "Score: %d", sim.score);
+        scoreText.setString(scoreBuffer);
+        worldView.setCenter(WIDTH / 2.0f, sim.cameraY + HEIGHT / 2.0f);
+        background.update(1.0f / TICK_RATE, 0, sim.cameraY);
+
+        target.clear();
+        target.setView(hudView);
+        background.draw(target);
+        target.setView(worldView);
+        platformRenderer.draw(target);
+        target.draw(particleRenderer.vertices);
+        target.draw(player.characterSprite);
+        target.setView(hudView);
+        target.draw(scoreText);
+        screen.display();
+        glFinish();
+        frameNs.push_back(clock.getElapsedTime().asMicroseconds() * 1e3);
+    }
+
+    std::sort(frameNs.begin(), frameNs.end());
+    bench.record({name, size, frameNs[frameNs.size() / 2], static_cast<std::uint64_t>(frames)});
+}
+
+// The background without shaders: a crossfade from red to blue shows both,
+// and once it ends only blue is left under the white snow.
+static bool checkBackgroundFallback() {
+    sf::Texture themes[THEME_COUNT];
+    const sf::Color colors[THEME_COUNT] = {sf::Color::Red, sf::Color::Blue, sf::Color::Green};
+    for (int i = 0; i < THEME_COUNT; i++) {
+        sf::Image image;
+        image.create(8, 8, colors[i]);
+        themes[i].loadFromImage(image);
+    }
+    sf::RenderTexture target;
+    if (!target.create(WIDTH, HEIGHT)) return false;
+    BackgroundRenderer background(false);
+    background.setThemes(themes);
+    background.setTheme(0, true);
+    background.setTheme(1, false);
+
+    auto frame = [&](float frameTime) {
+        background.update(frameTime, 0, 0);
+        target.clear();
+        background.draw(target);
+        target.display();
+        return target.getTexture().copyToImage();
+    };
+    sf::Image half = frame(THEME_FADE_TIME / 2);
+    sf::Color mid = half.getPixel(WIDTH / 2, HEIGHT / 2);
+    bool ok = mid.r > 0 && mid.b > 0;
+    if (!ok) std::cerr << "Background fallback: the crossfade does not show both themes." << std::endl;
+    for (int f = 0; f < 2; f++) {
+        sf::Image done = frame(THEME_FADE_TIME);
+        for (unsigned y = 0; y < HEIGHT && ok; y++) {
+            for (unsigned x = 0; x < WIDTH && ok; x++) {
+                sf::Color c = done.getPixel(x, y);
+                if (c.r > c.b || c.g > c.b) {
+                    std::cerr << "Background fallback: the old theme is still drawn after the fade." << std::endl;
+                    ok = false;
+                }
+            }
+        }
+    }
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    BenchRunner bench("render", argc, argv);
+    int frames = 300;
+    bool check = false;
+    for (const auto& arg : bench.extraArgs) {
+        if (arg.rfind("--frames=", 0) == 0) frames = std::max(1, std::atoi(arg.c_str() + 9));
+        else if (arg == "--check") check = true;
+        else {
+            std::cerr << "Unknown option " << arg << "." << std::endl;
+            return 1;
+        }
+    }
+
+    UpscaledTarget screen, large;
+    if (!screen.create(1) || !large.create(3)) {
+        std::cerr << "Failed to create render texture." << std::endl;
+        return 1;
+    }
+    screen.target().setActive(true);
+    if (check) {
+        bool ok = checkBackgroundFallback();
+        std::cout << "render checks " << (ok ? "passed" : "FAILED") << std::endl;
+        return ok ? 0 : 1;
+    }
+    TextureManager textures;
+    textures.finishLoading();
+
+    for (int platforms : {PLATFORM_COUNT, 1000}) {
+        renderFrames(bench, textures, screen, "frame_platforms", platforms, platforms, 50, frames);
+    }
+    for (int count : {50, 50000}) {
+        renderFrames(bench, textures, screen, "frame_particles", count, PLATFORM_COUNT, count, frames);
+    }
+    for (int percent : {100, 50}) {
+        large.setShare(percent / 100.0f);
+        renderFrames(bench, textures, large, "frame_render_share", percent, PLATFORM_COUNT, 50, frames);
+    }
+    return bench.finish();
+}
@@ -0,0 +1,237 @@
+#pragma once
+
+#include "sim.h"
+#include "profiler.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Shape of LookaheadBot's search. It looks segmentTicks * depth ticks ahead.
+struct BotConfig {
+    int segmentTicks = 6;   // ticks each choice is held for
+    int depth = 12;         // segments searched ahead
+    int beamWidth = 8;      // states kept per segment in each subtree
+    int threads = 0;        // 0 uses every core
+};
+
+// Steer left, right or neither, with or without a press of Space on the
+// segment's first tick. A press in the air is a double jump, one at a wall a
+// wall jump.
+const int BOT_ACTIONS = 6;
+
+inline std::uint8_t botInput(int action, int tickInSegment) {
+    static const std::uint8_t steer[3] = {0, INPUT_LEFT, INPUT_RIGHT};
+    std::uint8_t input = steer[action % 3];
+    if (action >= 3 && tickInSegment == 0) input |= INPUT_JUMP;
+    return input;
+}
+
+// Higher is better: height climbed and platforms scored, standing on
+// something, and staying clear of the bottom of the screen. Any death is
+// worse than any life; a later one is less bad.
+inline double botValue(const Simulation& sim) {
+    if (sim.gameOver) return -1e9 + static_cast<double>(sim.ticks);
+    const PlayerState& p = sim.player;
+    double climbed = HEIGHT - 100 - p.pos.y;
+    double danger = std::max(0.0f, p.pos.y - sim.cameraY - HEIGHT * 0.6f);
+    return climbed + 2.0 * sim.score + (p.canJump ? 20.0 : 0.0) - 4.0 * danger;
+}
+
+// Plays by searching input sequences on copies of the live simulation.
+// Every pair of first two segments is a task; the pool's threads take
+// tasks from a shared counter and run a beam search under each, and the
+// first segment of the best leaf found is played. Simulation copies into
+// warmed-up scratch states reuse their buffers, so planning does not touch
+// the heap, and the choice is the same on any number of threads.
+class LookaheadBot {
+public:
+    explicit LookaheadBot(const SimParams& params, const BotConfig& botConfig = BotConfig())
+        : config(botConfig), root(params) {
+        config.segmentTicks = std::max(2, config.segmentTicks);
+        config.depth = std::max(2, config.depth);
+        config.beamWidth = std::max(1, config.beamWidth);
+        if (config.threads <= 0) config.threads = std::max(1u, std::thread::hardware_concurrency());
+        scratch.reserve(config.threads);
+        for (int t = 0; t < config.threads; t++) scratch.emplace_back(params, config.beamWidth);
+        for (int t = 1; t < config.threads; t++) workers.emplace_back([this, t] { work(t); });
+    }
+
+    ~LookaheadBot() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
+        }
+        wake.notify_all();
+        for (auto& t : workers) t.join();
+    }
+
+    LookaheadBot(const LookaheadBot&) = delete;
+    LookaheadBot& operator=(const LookaheadBot&) = delete;
+
+    // This tick's input for sim, planning afresh at each segment's start.
+    std::uint8_t input(const Simulation& sim, float deltaTime) {
+        if (tickInSegment == 0) action = plan(sim, deltaTime);
+        std::uint8_t bits = botInput(action, tickInSegment);
+        tickInSegment = (tickInSegment + 1) % config.segmentTicks;
+        return bits;
+    }
+
+    // Searches from sim and returns the best action for the next segment.
+    int plan(const Simulation& sim, float deltaTime) {
+        root = sim;
+        // The tower worker is not safe to share; inline chunks are the same.
+        root.tower.source = nullptr;
+        stepTime = deltaTime;
+        nextTask.store(0, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending = static_cast<int>(workers.size());
+            generation++;
+        }
+        wake.notify_all();
+        bool wasMuted = Profiler::muted();
+        Profiler::muted() = true;
+        runTasks(scratch[0]);
+        Profiler::muted() = wasMuted;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            done.wait(lock, [this] { return pending == 0; });
+        }
+
+        int best = 0;
+        double bestValue = 0;
+        for (int task = 0; task < TASKS; task++) {
+            if (task == 0 || taskValue[task] > bestValue) {
+                best = task / BOT_ACTIONS;
+                bestValue = taskValue[task];
+            }
+        }
+        return best;
+    }
+
+    // Ticks stepped by the search so far, over all threads.
+    std::uint64_t simulatedTicks() const {
+        std::uint64_t total = 0;
+        for (const Scratch& s : scratch) total += s.ticks;
+        return total;
+    }
+
+    int threadCount() const { return config.threads; }
+
+private:
+    static const int TASKS = BOT_ACTIONS * BOT_ACTIONS;
+
+    // One thread's working states, built up front and copied over per search.
+    struct Scratch {
+        std::vector<Simulation> beam;
+        std::vector<Simulation> children;
+        std::vector<double> values;
+        std::vector<int> order;
+        std::uint64_t ticks = 0;
+
+        // Built one by one: a copy would only reserve what the original
+        // holds, not the room reset() sets aside for moving and crumbling
+        // platforms.
+        Scratch(const SimParams& params, int width) {
+            beam.reserve(width);
+            children.reserve(width * BOT_ACTIONS);
+            for (int i = 0; i < width; i++) beam.emplace_back(params);
+            for (int i = 0; i < width * BOT_ACTIONS; i++) children.emplace_back(params);
+            values.resize(children.size());
+            order.resize(children.size());
+        }
+    };
+
+    BotConfig config;
+    Simulation root;
+    float stepTime = 1.0f / TICK_RATE;
+    std::vector<Scratch> scratch;
+    double taskValue[TASKS] = {};
+    std::atomic<int> nextTask{0};
+    int action = 0;
+    int tickInSegment = 0;
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::uint64_t generation = 0;
+    int pending = 0;
+    bool quit = false;
+
+    void work(int index) {
+        Profiler::muted() = true;
+        std::uint64_t seen = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return quit || generation != seen; });
+                if (quit) return;
+                seen = generation;
+            }
+            runTasks(scratch[index]);
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--pending == 0) done.notify_one();
+        }
+    }
+
+    void runTasks(Scratch& s) {
+        for (int task = nextTask++; task < TASKS; task = nextTask++) taskValue[task] = search(task, s);
+    }
+
+    void runSegment(Simulation& sim, int segmentAction, Scratch& s) {
+        for (int t = 0; t < config.segmentTicks && !sim.gameOver; t++) {
+            sim.step(botInput(segmentAction, t), stepTime);
+            s.ticks++;
+        }
+    }
+
+    // Landing spots and jump phases repeat across actions; keeping one of
+    // each leaves the beam room for different ones.
+    static bool sameState(const Simulation& a, const Simulation& b) {
+        const PlayerState& p = a.player;
+        const PlayerState& q = b.player;
+        return p.pos.x == q.pos.x && p.pos.y == q.pos.y && p.vel.x == q.vel.x && p.vel.y == q.vel.y &&
+               p.canJump == q.canJump && p.canDoubleJump == q.canDoubleJump && a.score == b.score;
+    }
+
+    // Value of the best leaf under the task's first two segments.
+    double search(int task, Scratch& s) {
+        s.beam[0] = root;
+        runSegment(s.beam[0], task / BOT_ACTIONS, s);
+        runSegment(s.beam[0], task % BOT_ACTIONS, s);
+        int width = 1;
+        double best = botValue(s.beam[0]);
+        for (int d = 2; d < config.depth; d++) {
+            int count = 0;
+            for (int i = 0; i < width; i++) {
+                for (int a = 0; a < BOT_ACTIONS; a++) {
+                    // The dead go nowhere whatever they press.
+                    if (a > 0 && s.beam[i].gameOver) break;
+                    Simulation& child = s.children[count];
+                    child = s.beam[i];
+                    runSegment(child, a, s);
+                    s.values[count] = botValue(child);
+                    s.order[count] = count;
+                    count++;
+                }
+            }
+            std::sort(s.order.begin(), s.order.begin() + count, [&](int a, int b) {
+                return s.values[a] != s.values[b] ? s.values[a] > s.values[b] : a < b;
+            });
+            best = s.values[s.order[0]];
+            width = 0;
+            for (int j = 0; j < count && width < config.beamWidth; j++) {
+                Simulation& candidate = s.children[s.order[j]];
+                bool seen = false;
+                for (int k = 0; k < width && !seen; k++) seen = sameState(s.beam[k], candidate);
+                if (!seen) std::swap(s.beam[width++], candidate);
+            }
+        }
+        return best;
+    }
+};
@@ -0,0 +1,353 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <SFML/OpenGL.hpp>
+#include "profiler.h"
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Most encoder threads a capture starts, and most memory its frame buffers
+// may take; a large capture gets fewer buffers, never fewer than three.
+const int CAPTURE_MAX_WORKERS = 4;
+const std::size_t CAPTURE_POOL_BYTES = std::size_t(256) << 20;
+
+// Writes captured frames on a pool of worker threads, either as a PNG
+// sequence in a directory or as one YUV4MPEG2 (.y4m) stream, which ffmpeg
+// and most players read directly. Frames arrive bottom-up RGBA, as
+// glReadPixels returns them. A fixed set of frame buffers is recycled.
+class FrameEncoder {
+public:
+    // A .y4m path is a video stream; anything else is a PNG directory.
+    bool open(const std::string& path, unsigned frameWidth, unsigned frameHeight, int frameRate, int workerCount) {
+        width = frameWidth;
+        height = frameHeight;
+        video = std::filesystem::path(path).extension() == ".y4m";
+        directory = path;
+        if (video) {
+            std::error_code ec;
+            std::filesystem::path parent = std::filesystem::path(path).parent_path();
+            if (!parent.empty()) std::filesystem::create_directories(parent, ec);
+            stream = std::fopen(path.c_str(), "wb");
+            if (!stream) return false;
+            std::fprintf(stream, "YUV4MPEG2 W%u H%u F%d:1 Ip A1:1 C420jpeg\n", width, height, frameRate);
+        } else {
+            std::error_code ec;
+            std::filesystem::create_directories(path, ec);
+            if (ec) return false;
+        }
+        std::size_t frameBytes = std::size_t(width) * height * 4;
+        if (video) frameBytes += std::size_t(width) * height + 2 * chromaSize();
+        std::size_t wanted = std::size_t(2 * workerCount + 2);
+        frames.assign(std::max<std::size_t>(3, std::min(wanted, CAPTURE_POOL_BYTES / frameBytes)), Frame());
+        idle.clear();
+        queue.clear();
+        submitted = 0;
+        nextWrite = 0;
+        for (Frame& frame : frames) {
+            frame.rgba.resize(std::size_t(width) * height * 4);
+            if (video) frame.yuv.resize(std::size_t(width) * height + 2 * chromaSize());
+            idle.push_back(&frame);
+        }
+        running = true;
+        for (int i = 0; i < workerCount; i++) workers.emplace_back([this] { work(); });
+        return true;
+    }
+
+    // A free buffer for the next frame, or null if every buffer is queued
+    // and wait is false.
+    std::uint8_t* acquire(bool wait) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (wait) changed.wait(lock, [&] { return !idle.empty(); });
+        if (idle.empty()) return nullptr;
+        Frame* frame = idle.back();
+        idle.pop_back();
+        filling = frame;
+        return frame->rgba.data();
+    }
+
+    // Queues the buffer from the last acquire().
+    void submit() {
+        std::lock_guard<std::mutex> lock(mutex);
+        filling->index = submitted++;
+        queue.push_back(filling);
+        filling = nullptr;
+        changed.notify_all();
+    }
+
+    // Hands the buffer from the last acquire() back unused.
+    void release() {
+        std::lock_guard<std::mutex> lock(mutex);
+        idle.push_back(filling);
+        filling = nullptr;
+        changed.notify_all();
+    }
+
+    // Finishes everything queued and closes the output.
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running = false;
+            changed.notify_all();
+        }
+        for (std::thread& worker : workers) worker.join();
+        workers.clear();
+        if (stream) std::fclose(stream);
+        stream = nullptr;
+    }
+
+    std::uint64_t written() const { return submitted; }
+
+private:
+    struct Frame {
+        std::vector<std::uint8_t> rgba;
+        std::vector<std::uint8_t> yuv;
+        std::uint64_t index = 0;
+    };
+
+    unsigned width = 0, height = 0;
+    bool video = false;
+    std::string directory;
+    std::FILE* stream = nullptr;
+    std::vector<Frame> frames;
+    std::vector<Frame*> idle;
+    std::deque<Frame*> queue;
+    Frame* filling = nullptr;
+    std::uint64_t submitted = 0;
+    std::uint64_t nextWrite = 0;
+    bool running = false;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::vector<std::thread> workers;
+
+    std::size_t chromaSize() const { return std::size_t((width + 1) / 2) * ((height + 1) / 2); }
+
+    void work() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            changed.wait(lock, [&] { return !queue.empty() || !running; });
+            if (queue.empty()) return;
+            Frame* frame = queue.front();
+            queue.pop_front();
+            lock.unlock();
+            if (video) {
+                toYuv(*frame);
+                lock.lock();
+                // Frames are converted in parallel but written in order.
+                changed.wait(lock, [&] { return nextWrite == frame->index; });
+                std::fputs("FRAME\n", stream);
+                std::fwrite(frame->yuv.data(), 1, frame->yuv.size(), stream);
+                nextWrite++;
+            } else {
+                writePng(*frame);
+                lock.lock();
+            }
+            idle.push_back(frame);
+            changed.notify_all();
+        }
+    }
+
+    void writePng(Frame& frame) {
+        for (std::size_t i = 3; i < frame.rgba.size(); i += 4) frame.rgba[i] = 255;
+        sf::Image image;
+        image.create(width, height, frame.rgba.data());
+        image.flipVertically();
+        char name[32];
+        std::snprintf(name, sizeof(name), "frame-%06llu.png", static_cast<unsigned long long>(frame.index));
+        std::string path = directory + "/" + name;
+        if (!image.saveToFile(path)) std::cerr << "Failed to write " << path << "." << std::endl;
+    }
+
+    static std::uint8_t clampByte(int v) { return static_cast<std::uint8_t>(std::min(255, std::max(0, v))); }
+
+    // Full-range BT.601 4:2:0, flipped to top-down on the way.
+    void toYuv(Frame& frame) {
+        const std::size_t chromaWidth = (width + 1) / 2;
+        std::uint8_t* yPlane = frame.yuv.data();
+        std::uint8_t* uPlane = yPlane + std::size_t(width) * height;
+        std::uint8_t* vPlane = uPlane + chromaSize();
+        for (unsigned y = 0; y < height; y++) {
+            const std::uint8_t* row = &frame.rgba[std::size_t(height - 1 - y) * width * 4];
+            std::uint8_t* out = yPlane + std::size_t(y) * width;
+            for (unsigned x = 0; x < width; x++) {
+                const std::uint8_t* p = row + x * 4;
+                out[x] = static_cast<std::uint8_t>((77 * p[0] + 150 * p[1] + 29 * p[2] + 128) >> 8);
+            }
+        }
+        for (unsigned cy = 0; cy < (height + 1) / 2; cy++) {
+            for (unsigned cx = 0; cx < chromaWidth; cx++) {
+                int r = 0, g = 0, b = 0, n = 0;
+                for (unsigned y = cy * 2; y < std::min(cy * 2 + 2, height); y++) {
+                    for (unsigned x = cx * 2; x < std::min(cx * 2 + 2, width); x++) {
+                        const std::uint8_t* p = &frame.rgba[(std::size_t(height - 1 - y) * width + x) * 4];
+                        r += p[0];
+                        g += p[1];
+                        b += p[2];
+                        n++;
+                    }
+                }
+                r /= n;
+                g /= n;
+                b /= n;
+                uPlane[cy * chromaWidth + cx] = clampByte(((-43 * r - 85 * g + 128 * b + 128) >> 8) + 128);
+                vPlane[cy * chromaWidth + cx] = clampByte(((128 * r - 107 * g - 21 * b + 128) >> 8) + 128);
+            }
+        }
+    }
+};
+
+// Reads the active framebuffer out through two pixel-pack buffers in turn:
+// each frame starts an asynchronous glReadPixels into one and maps the
+// other, whose transfer was started a frame ago and has finished by now, so
+// the render thread never waits on the GPU. Without buffer objects it falls
+// back to a plain, blocking glReadPixels.
+class FrameCapture {
+public:
+    ~FrameCapture() { stop(); }
+
+    bool active() const { return capturing; }
+
+    // Live capture drops a frame rather than stall when the encoders are
+    // behind; offline rendering waits for them.
+    bool start(const std::string& path, unsigned frameWidth, unsigned frameHeight, int frameRate, bool wait) {
+        int workerCount = std::clamp(static_cast<int>(std::thread::hardware_concurrency()) - 1, 1, CAPTURE_MAX_WORKERS);
+        if (!encoder.open(path, frameWidth, frameHeight, frameRate, workerCount)) {
+            std::cerr << "Failed to open " << path << " for capture." << std::endl;
+            return false;
+        }
+        width = frameWidth;
+        height = frameHeight;
+        waitForEncoder = wait;
+        target = path;
+        grabbed = 0;
+        dropped = 0;
+        loadFunctions();
+        if (genBuffers) {
+            genBuffers(2, pbo);
+            for (GLuint buffer : pbo) {
+                bindBuffer(PIXEL_PACK_BUFFER, buffer);
+                bufferData(PIXEL_PACK_BUFFER, std::ptrdiff_t(width) * height * 4, nullptr, STREAM_READ);
+            }
+            bindBuffer(PIXEL_PACK_BUFFER, 0);
+        }
+        capturing = true;
+        return true;
+    }
+
+    // Render thread, after drawing and before display().
+    void grab() {
+        if (!capturing) return;
+        PROFILE_SCOPE(Phase::Capture);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        if (!genBuffers) {
+            std::uint8_t* frame = encoder.acquire(waitForEncoder);
+            if (!frame) {
+                dropped++;
+                return;
+            }
+            glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, frame);
+            encoder.submit();
+            return;
+        }
+        int current = grabbed % 2;
+        bindBuffer(PIXEL_PACK_BUFFER, pbo[current]);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        if (grabbed > 0) collect(pbo[1 - current]);
+        bindBuffer(PIXEL_PACK_BUFFER, 0);
+        grabbed++;
+    }
+
+    // Collects the frame still in flight and waits for the encoders.
+    void stop() {
+        if (!capturing) return;
+        capturing = false;
+        if (genBuffers) {
+            if (grabbed > 0) {
+                collect(pbo[(grabbed - 1) % 2]);
+                bindBuffer(PIXEL_PACK_BUFFER, 0);
+            }
+            deleteBuffers(2, pbo);
+        }
+        encoder.close();
+        std::cout << "Captured " << encoder.written() << " frames to " << target;
+        if (dropped > 0) std::cout << " (" << dropped << " dropped while the encoders were busy)";
+        std::cout << "." << std::endl;
+    }
+
+private:
+    FrameEncoder encoder;
+    unsigned width = 0, height = 0;
+    bool capturing = false;
+    bool waitForEncoder = false;
+    std::string target;
+    GLuint pbo[2] = {0, 0};
+    std::uint64_t grabbed = 0;
+    std::uint64_t dropped = 0;
+
+    // Buffer objects are core since OpenGL 1.5, but the system headers on
+    // Windows stop at 1.1 and not every libGL exports them, so the entry
+    // points and enums are declared here and looked up through the context.
+#if defined(_WIN32)
+#define ICY_GL_CALL __stdcall
+#else
+#define ICY_GL_CALL
+#endif
+    typedef void(ICY_GL_CALL* GenBuffersFn)(GLsizei, GLuint*);
+    typedef void(ICY_GL_CALL* DeleteBuffersFn)(GLsizei, const GLuint*);
+    typedef void(ICY_GL_CALL* BindBufferFn)(GLenum, GLuint);
+    typedef void(ICY_GL_CALL* BufferDataFn)(GLenum, std::ptrdiff_t, const void*, GLenum);
+    typedef void*(ICY_GL_CALL* MapBufferFn)(GLenum, GLenum);
+    typedef GLboolean(ICY_GL_CALL* UnmapBufferFn)(GLenum);
+#undef ICY_GL_CALL
+    static const GLenum PIXEL_PACK_BUFFER = 0x88EB;
+    static const GLenum STREAM_READ = 0x88E1;
+    static const GLenum READ_ONLY = 0x88B8;
+
+    GenBuffersFn genBuffers = nullptr;
+    DeleteBuffersFn deleteBuffers = nullptr;
+    BindBufferFn bindBuffer = nullptr;
+    BufferDataFn bufferData = nullptr;
+    MapBufferFn mapBuffer = nullptr;
+    UnmapBufferFn unmapBuffer = nullptr;
+
+    void loadFunctions() {
+        genBuffers = reinterpret_cast<GenBuffersFn>(sf::Context::getFunction("glGenBuffers"));
+        deleteBuffers = reinterpret_cast<DeleteBuffersFn>(sf::Context::getFunction("glDeleteBuffers"));
+        bindBuffer = reinterpret_cast<BindBufferFn>(sf::Context::getFunction("glBindBuffer"));
+        bufferData = reinterpret_cast<BufferDataFn>(sf::Context::getFunction("glBufferData"));
+        mapBuffer = reinterpret_cast<MapBufferFn>(sf::Context::getFunction("glMapBuffer"));
+        unmapBuffer = reinterpret_cast<UnmapBufferFn>(sf::Context::getFunction("glUnmapBuffer"));
+        if (!genBuffers || !deleteBuffers || !bindBuffer || !bufferData || !mapBuffer || !unmapBuffer) {
+            genBuffers = nullptr;
+        }
+    }
+
+    // Copies a finished transfer into a free encoder buffer.
+    void collect(GLuint buffer) {
+        bindBuffer(PIXEL_PACK_BUFFER, buffer);
+        std::uint8_t* frame = encoder.acquire(waitForEncoder);
+        if (!frame) {
+            dropped++;
+            return;
+        }
+        const void* pixels = mapBuffer(PIXEL_PACK_BUFFER, READ_ONLY);
+        if (!pixels) {
+            encoder.release();
+            dropped++;
+            return;
+        }
+        std::memcpy(frame, pixels, std::size_t(width) * height * 4);
+        unmapBuffer(PIXEL_PACK_BUFFER);
+        encoder.submit();
+    }
+};
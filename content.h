@@ -0,0 +1,121 @@
+#pragma once
+
+#include "sim.h"
+#include <climits>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+// platforms.cfg: one platform kind or pickup per line,
+//   platform NAME key=value ...
+//   pickup NAME key=value ...
+// '#' starts a comment. Platform keys: weight, from, speed, range, crumble,
+// friction, bounce, tint. Pickup keys: chance, from, duration, speed, jumps,
+// tint. Tints are RRGGBB or RRGGBBAA. friction is the share of the steering
+// applied per 60 Hz tick, scaled to the tick rate. The first platform kind is
+// also the ground, so it may not move, crumble or bounce.
+
+inline bool parseTint(const std::string& text, std::uint32_t& out) {
+    if (text.size() != 6 && text.size() != 8) return false;
+    char* end;
+    unsigned long value = std::strtoul(text.c_str(), &end, 16);
+    if (*end != '\0') return false;
+    out = static_cast<std::uint32_t>(text.size() == 6 ? value << 8 | 0xFF : value);
+    return true;
+}
+
+inline bool parseNumber(const std::string& text, float& out) {
+    char* end;
+    out = std::strtof(text.c_str(), &end);
+    return end != text.c_str() && *end == '\0';
+}
+
+// Whole, non-negative numbers only; "1.5" or "2e0" is an error, not a 1 or a 2.
+inline bool parseCount(const std::string& text, int& out) {
+    char* end;
+    long value = std::strtol(text.c_str(), &end, 10);
+    if (end == text.c_str() || *end != '\0' || value < 0 || value > INT_MAX) return false;
+    out = static_cast<int>(value);
+    return true;
+}
+
+inline bool setPlatformKey(PlatformKind& kind, const std::string& key, const std::string& value) {
+    if (key == "tint") return parseTint(value, kind.tint);
+    float* field = key == "weight" ? &kind.weight : key == "from" ? &kind.fromHeight
+                 : key == "speed" ? &kind.moveSpeed : key == "range" ? &kind.moveRange
+                 : key == "crumble" ? &kind.crumbleTime : key == "friction" ? &kind.friction
+                 : key == "bounce" ? &kind.bounce : nullptr;
+    return field && parseNumber(value, *field) && *field >= 0;
+}
+
+inline bool setPickupKey(PickupKind& kind, const std::string& key, const std::string& value) {
+    if (key == "tint") return parseTint(value, kind.tint);
+    if (key == "jumps") return parseCount(value, kind.extraJumps);
+    float* field = key == "chance" ? &kind.chance : key == "from" ? &kind.fromHeight
+                 : key == "duration" ? &kind.duration : key == "speed" ? &kind.speedScale : nullptr;
+    return field && parseNumber(value, *field) && *field >= 0;
+}
+
+// Replaces the platform kinds and pickups in params; the other tunables are
+// left alone. On failure params is untouched and error says why.
+inline bool loadContent(const std::string& path, SimParams& params, std::string& error) {
+    std::ifstream file(path);
+    if (!file) {
+        error = "Failed to open " + path + ".";
+        return false;
+    }
+    SimParams loaded = params;
+    loaded.platformKindCount = 0;
+    loaded.pickupKindCount = 0;
+    std::string line;
+    for (int number = 1; std::getline(file, line); number++) {
+        std::istringstream words(line.substr(0, line.find('#')));
+        std::string what, name, pair;
+        if (!(words >> what)) continue;
+        std::string where = path + ":" + std::to_string(number) + ": ";
+        bool platform = what == "platform";
+        if (!platform && what != "pickup") {
+            error = where + "expected platform or pickup, got " + what + ".";
+            return false;
+        }
+        if (!(words >> name)) {
+            error = where + "missing name.";
+            return false;
+        }
+        int& count = platform ? loaded.platformKindCount : loaded.pickupKindCount;
+        if (count == (platform ? MAX_PLATFORM_KINDS : MAX_PICKUP_KINDS)) {
+            error = where + "too many " + what + " kinds.";
+            return false;
+        }
+        if (platform) loaded.platformKinds[count] = PlatformKind();
+        else loaded.pickupKinds[count] = PickupKind();
+        while (words >> pair) {
+            std::size_t equals = pair.find('=');
+            std::string key = pair.substr(0, equals);
+            std::string value = equals == std::string::npos ? "" : pair.substr(equals + 1);
+            bool ok = platform ? setPlatformKey(loaded.platformKinds[count], key, value)
+                               : setPickupKey(loaded.pickupKinds[count], key, value);
+            if (!ok) {
+                error = where + "bad " + name + " setting " + pair + ".";
+                return false;
+            }
+        }
+        const PlatformKind& kind = loaded.platformKinds[count];
+        if (platform && (kind.friction <= 0 || kind.friction > 1)) {
+            error = where + name + " needs a friction above 0 and at most 1.";
+            return false;
+        }
+        if (platform && count == 0 && (kind.moveSpeed > 0 || kind.crumbleTime > 0 || kind.bounce > 0)) {
+            error = where + name + " is the ground's kind and may not move, crumble or bounce.";
+            return false;
+        }
+        count++;
+    }
+    if (loaded.platformKindCount == 0) {
+        error = path + " lists no platform kinds.";
+        return false;
+    }
+    params = loaded;
+    return true;
+}
@@ -1,230 +1,58 @@
 #include <SFML/Graphics.hpp>
+#include "sim.h"
+#include "particles.h"
+#include "alloc_tracker.h"
+#include "replay.h"
+#include "profiler.h"
+#include "render.h"
+#include "tower.h"
+#include "snapshot.h"
+#include "input.h"
+#include "net_socket.h"
+#include "content.h"
+#include "capture.h"
+#include "scene.h"
+#include "bot.h"
+#include "upscale.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
 #include <vector>
 #include <cstdlib>
 #include <ctime>
 #include <string>
-#include <sstream>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <cmath>
+#include <filesystem>
+#include <memory>
+#include <random>
 
-const int WIDTH = 400;
-const int HEIGHT = 600;
-const int PLATFORM_COUNT = 12;
-const float GRAVITY = 0.35f;
-const float JUMP_FORCE = -12.0f;
-const float WALL_JUMP_FORCE = -8.0f;
-const float PLAYER_MAX_SPEED = 4.0f;
-const float DOUBLE_JUMP_FORCE = -10.0f;
-const float PLATFORM_SPACING = 80.0f;
-const float WALL_BOUNCE_DAMPING = 0.7f;
+// How long the game-over screen stays up before autoplay starts again.
+const std::chrono::seconds AUTOPLAY_RESTART_DELAY(3);
 
-enum class PlatformType { Normal };
-
-class TextureManager {
-public:
-    sf::Texture playerTexture;
-    sf::Texture platformTexture;
-    std::vector<sf::Texture> backgroundTextures;
-    sf::Texture gameOverTexture;
-    sf::Font font;
-
-    TextureManager() {
-        if (!playerTexture.loadFromFile("pop.png")) {
-            std::cerr << "Failed to load pop.png." << std::endl;
-            exit(1);
-        }
-        if (!platformTexture.loadFromFile("step.png")) {
-            std::cerr << "Failed to load step.png." << std::endl;
-            exit(1);
-        }
-        sf::Texture bg1, bg2, bg3;
-        if (!bg1.loadFromFile("background.png")) {
-            std::cerr << "Failed to load background.png." << std::endl;
-            exit(1);
-        }
-        if (!bg2.loadFromFile("sunset.png")) {
-            std::cerr << "Failed to load sunset.png." << std::endl;
-            exit(1);
-        }
-        if (!bg3.loadFromFile("night.png")) {
-            std::cerr << "Failed to load night.png." << std::endl;
-            exit(1);
-        }
-        backgroundTextures.push_back(bg1);
-        backgroundTextures.push_back(bg2);
-        backgroundTextures.push_back(bg3);
-        if (!gameOverTexture.loadFromFile("gameover.png")) {
-            std::cerr << "Failed to load gameover.png." << std::endl;
-            exit(1);
-        }
-        if (!font.loadFromFile("DejaVuSans.ttf")) {
-            std::cerr << "Failed to load DejaVuSans.ttf." << std::endl;
-            exit(1);
-        }
-    }
-};
-
-class Platform {
-public:
-    sf::Sprite shape;
-    sf::Sprite shadow;
-    PlatformType type;
-    bool active;
-    bool scored;
-
-    Platform(float x, float y, PlatformType t, sf::Texture& texture) 
-        : type(t), active(true), scored(false) {
-        shape.setTexture(texture);
-        shape.setPosition(x, y);
-        sf::Vector2u textureSize = texture.getSize();
-        shape.setScale(120.0f / textureSize.x, 15.0f / textureSize.y);
-
-        shadow.setTexture(texture);
-        shadow.setPosition(x + 5, y + 5);
-        shadow.setScale(120.0f / textureSize.x, 15.0f / textureSize.y);
-        shadow.setColor(sf::Color(0, 0, 0, 100));
-    }
-
-    void update(float deltaTime) {
-        // Static platforms
-    }
-};
-
-class Particle {
-public:
-    sf::CircleShape shape;
-    sf::Vector2f velocity;
-    float lifetime;
-
-    Particle(float x, float y, float size = 2.0f) : lifetime(0.5f) {
-        shape.setRadius(size);
-        shape.setFillColor(sf::Color(rand() % 255, rand() % 255, rand() % 255, 200));
-        shape.setPosition(x, y);
-        velocity = sf::Vector2f((rand() % 200 - 100) / 100.0f, (rand() % 200 - 100) / 100.0f);
-    }
-
-    bool update(float deltaTime) {
-        shape.move(velocity * deltaTime * 60.0f);
-        lifetime -= deltaTime;
-        shape.setFillColor(sf::Color(
-            shape.getFillColor().r,
-            shape.getFillColor().g,
-            shape.getFillColor().b,
-            static_cast<sf::Uint8>(200 * lifetime / 0.5f)
-        ));
-        return lifetime <= 0;
+static std::uint8_t inputBits(sf::Keyboard::Key key) {
+    switch (key) {
+        case sf::Keyboard::Left: return INPUT_LEFT;
+        case sf::Keyboard::Right: return INPUT_RIGHT;
+        case sf::Keyboard::Space: return INPUT_JUMP;
+        default: return 0;
     }
-};
-
-class Player {
-public:
-    sf::Sprite characterSprite;
-    float dx, dy;
-    bool canJump, canDoubleJump, isWallJumping, facingRight;
-    sf::Vector2f lastWall;
-
-    Player(float x, float y, sf::Texture& texture) 
-        : dx(0), dy(0), canJump(true), canDoubleJump(false), isWallJumping(false), facingRight(true) {
-        characterSprite.setTexture(texture);
-        characterSprite.setPosition(x, y);
-        sf::Vector2u textureSize = texture.getSize();
-        characterSprite.setScale(40.0f / textureSize.x, 40.0f / textureSize.y);
-    }
-
-    void reset(float x, float y) {
-        characterSprite.setPosition(x, y);
-        dx = 0;
-        dy = 0;
-        canJump = true;
-        canDoubleJump = false;
-        isWallJumping = false;
-        facingRight = true;
-    }
-
-    void update(float deltaTime) {
-        dy += GRAVITY * deltaTime * 60.0f;
-        characterSprite.move(dx * deltaTime * 60.0f, dy * deltaTime * 60.0f);
-
-        if (dx > 0 && !facingRight) {
-            facingRight = true;
-            characterSprite.setScale(std::abs(characterSprite.getScale().x), characterSprite.getScale().y);
-        } else if (dx < 0 && facingRight) {
-            facingRight = false;
-            characterSprite.setScale(-std::abs(characterSprite.getScale().x), characterSprite.getScale().y);
-        }
-    }
-
-    void handleInput() {
-        dx = 0;
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Left)) dx = -PLAYER_MAX_SPEED;
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Right)) dx = PLAYER_MAX_SPEED;
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Space) && (canJump || canDoubleJump)) {
-            if (canJump) {
-                dy = JUMP_FORCE;
-                canJump = false;
-                canDoubleJump = true;
-            } else if (canDoubleJump) {
-                dy = DOUBLE_JUMP_FORCE;
-                canDoubleJump = false;
-            }
-        }
-    }
-
-    void checkWallJump() {
-        sf::FloatRect bounds = getBounds();
-        if (!canJump && bounds.left <= 0 && sf::Keyboard::isKeyPressed(sf::Keyboard::Space)) {
-            dy = WALL_JUMP_FORCE;
-            dx = PLAYER_MAX_SPEED;
-            isWallJumping = true;
-            lastWall = sf::Vector2f(0, bounds.top);
-        } else if (!canJump && bounds.left >= WIDTH - bounds.width && sf::Keyboard::isKeyPressed(sf::Keyboard::Space)) {
-            dy = WALL_JUMP_FORCE;
-            dx = -PLAYER_MAX_SPEED;
-            isWallJumping = true;
-            lastWall = sf::Vector2f(WIDTH, bounds.top);
-        } else if (isWallJumping && std::abs(bounds.top - lastWall.y) > 50) {
-            isWallJumping = false;
-            if (sf::Keyboard::isKeyPressed(sf::Keyboard::Left)) dx = -PLAYER_MAX_SPEED;
-            else if (sf::Keyboard::isKeyPressed(sf::Keyboard::Right)) dx = PLAYER_MAX_SPEED;
-            else dx = 0;
-        }
-    }
-
-    void handleWallCollision() {
-        sf::FloatRect bounds = getBounds();
-        if (bounds.left <= 0) {
-            characterSprite.setPosition(0, bounds.top);
-            dx = -dx * WALL_BOUNCE_DAMPING;
-            spawnParticles(0, bounds.top + bounds.height / 2, 3.0f);
-        } else if (bounds.left >= WIDTH - bounds.width) {
-            characterSprite.setPosition(WIDTH - bounds.width, bounds.top);
-            dx = -dx * WALL_BOUNCE_DAMPING;
-            spawnParticles(WIDTH, bounds.top + bounds.height / 2, 3.0f);
-        }
-    }
-
-    sf::FloatRect getBounds() const {
-        return characterSprite.getGlobalBounds();
-    }
-
-private:
-    void spawnParticles(float x, float y, float size) {
-        for (int i = 0; i < 5; i++) {
-            Particle particle(x, y, size);
-        }
-    }
-};
+}
 
+// The title screen, drawn into the game's own window.
 class Menu {
 public:
-    sf::RenderWindow window;
+    enum Choice { None, Play, Exit };
+
     std::vector<sf::Text> menuItems;
     sf::Text welcomeText;
     int selectedItem;
     sf::Font& font;
     sf::Sprite backgroundSprite;
 
-    Menu(sf::Font& f, sf::Texture& bgTexture) : window(sf::VideoMode(WIDTH, HEIGHT), "Icy Tower Menu"), selectedItem(0), font(f) {
+    Menu(sf::Font& f, sf::Texture& bgTexture) : selectedItem(0), font(f) {
         backgroundSprite.setTexture(bgTexture);
         backgroundSprite.setScale(
             static_cast<float>(WIDTH) / bgTexture.getSize().x,
@@ -246,37 +74,27 @@ public:
         }
     }
 
-    bool run() {
-        while (window.isOpen()) {
-            sf::Event event;
-            while (window.pollEvent(event)) {
-                if (event.type == sf::Event::Closed) window.close();
-                if (event.type == sf::Event::KeyReleased) {
-                    if (event.key.code == sf::Keyboard::Up) {
-                        menuItems[selectedItem].setFillColor(sf::Color::White);
-                        selectedItem = (selectedItem - 1 + 2) % 2;
-                        menuItems[selectedItem].setFillColor(sf::Color::Yellow);
-                    }
-                    if (event.key.code == sf::Keyboard::Down) {
-                        menuItems[selectedItem].setFillColor(sf::Color::White);
-                        selectedItem = (selectedItem + 1) % 2;
-                        menuItems[selectedItem].setFillColor(sf::Color::Yellow);
-                    }
-                    if (event.key.code == sf::Keyboard::Return) {
-                        window.close();
-                        return selectedItem == 0;
-                    }
-                }
-            }
-            window.clear();
-            window.draw(backgroundSprite);
-            window.draw(welcomeText);
-            for (const auto& item : menuItems) {
-                window.draw(item);
-            }
-            window.display();
+    void select(int item) {
+        menuItems[selectedItem].setFillColor(sf::Color::White);
+        selectedItem = item;
+        menuItems[selectedItem].setFillColor(sf::Color::Yellow);
+    }
+
+    Choice keyPressed(sf::Keyboard::Key key) {
+        if (key == sf::Keyboard::Up) select((selectedItem - 1 + 2) % 2);
+        if (key == sf::Keyboard::Down) select((selectedItem + 1) % 2);
+        if (key == sf::Keyboard::Return) return selectedItem == 0 ? Play : Exit;
+        return None;
+    }
+
+    // Returns the number of draw calls.
+    int draw(sf::RenderTarget& target) const {
+        target.draw(backgroundSprite);
+        target.draw(welcomeText);
+        for (const auto& item : menuItems) {
+            target.draw(item);
         }
-        return false;
+        return 2 + static_cast<int>(menuItems.size());
     }
 };
 
@@ -284,32 +102,91 @@ class Game {
 private:
     sf::RenderWindow window;
     TextureManager textures;
-    Player player;
-    std::vector<Platform> platforms;
-    std::vector<Particle> particles;
-    sf::Sprite backgroundSprite;
-    sf::Sprite gameOverSprite;
-    sf::Text scoreText, highScoreText, retryText, quitText, pauseText, finalScoreText;
-    float highestY;
-    int score, highScore;
-    bool gameOver;
-    bool paused;
-    float cameraY;
+
+    // Simulation thread. Once the game is running the render thread only
+    // sees this state through published snapshots.
+    Simulation sim;
+    TowerWorker towerWorker;
+    PlayerState prevPlayer;
+    float prevCameraY;
+    ParticlePool particles;
+    int highScore;
     float backgroundOffset;
     float scorePulseTimer;
     int currentLevel;
+    float tickTime;
+    int tickRate;
+    std::uint32_t runCount;
+    std::uint64_t tickCount;
+    std::chrono::steady_clock::time_point lastTickTime;
+    InputSampler inputSampler;
+    InputClock::time_point lastPressTime;
+    InputRecorder recorder;
+    // Race mode; null when playing alone. Set before the threads start.
+    std::unique_ptr<RaceConnection> race;
+    std::uint8_t carriedPress;
+    // --autoplay; null when the keyboard plays. Set before the threads start.
+    std::unique_ptr<LookaheadBot> autoplay;
+
+    // Shared.
+    TripleBuffer<FrameSnapshot> snapshots;
+    InputQueue inputQueue;
+    std::atomic<bool> paused{false};
+    std::atomic<bool> resetRequested{false};
+    std::atomic<bool> simRunning{false};
+    std::thread simThread;
+
+    // Render thread.
+    SceneStack scenes;
+    Menu menu;
+    // Everything is drawn at the logical WIDTH x HEIGHT into screen, which is
+    // then upscaled onto the window.
+    UpscaledTarget screen;
+    DynamicResolution resolution;
+    unsigned renderScale;
+    bool integerScaling;
+    bool dynamicResolution;
+    bool fullscreen;
+    sf::View worldView;
+    sf::View hudView;
+    Player player;
+    PlatformRenderer platformRenderer;
+    ParticleRenderer particleRenderer;
+    PickupRenderer pickupRenderer;
+    BackgroundRenderer background;
+    sf::Sprite gameOverSprite;
+    sf::Text scoreText, highScoreText, retryText, quitText, menuText, pauseText, finalScoreText, standingsText;
+    Player ghost;
+    char shownStandings[128];
+    sf::RectangleShape pauseOverlay;
+    sf::RectangleShape effectBar;
+    sf::Color effectTints[MAX_PICKUP_KINDS];
+    FrameCapture capture;
+    std::string capturePath;
+    int shownScore, shownHighScore;
+    int shownLevel;
+    std::uint32_t shownRun;
+    int frameRate;
+    InputClock::time_point nextFrameTime;
+    bool measureLatency;
+    LatencyStats latency;
+    InputClock::time_point shownPressTime;
+    int allocCheckFrames;
+    ProfilerOverlay profilerOverlay;
+    int drawCalls;
+    bool traceOnExit;
 
 public:
-    Game() : player(WIDTH / 2, HEIGHT - 100, textures.playerTexture),
-             highestY(HEIGHT - 100), score(0), highScore(0), gameOver(false), paused(false), 
-             cameraY(0), backgroundOffset(0), scorePulseTimer(0.0f), currentLevel(0) {
-        updateBackground();
-        gameOverSprite.setTexture(textures.gameOverTexture);
-        gameOverSprite.setScale(
-            static_cast<float>(WIDTH) / gameOverSprite.getTexture()->getSize().x,
-            static_cast<float>(HEIGHT) / gameOverSprite.getTexture()->getSize().y
-        );
-        gameOverSprite.setPosition(0, 0);
+    Game(const SimParams& params, int tickRate = TICK_RATE, int frameRate = 60)
+           : sim(params), towerWorker(sim.params), particles(MAX_PARTICLES, static_cast<std::uint64_t>(time(0))),
+             highScore(0), backgroundOffset(0), scorePulseTimer(0.0f), currentLevel(0),
+             tickTime(1.0f / tickRate), tickRate(tickRate), runCount(0), tickCount(0), carriedPress(0),
+             scenes(Scene::Menu), menu(textures.font, textures.backgroundTextures[0]), renderScale(1), integerScaling(true),
+             dynamicResolution(false), fullscreen(false), platformRenderer(textures.platformTexture), shownScore(-1), shownHighScore(-1),
+             shownLevel(-1), shownRun(0), frameRate(frameRate), measureLatency(false), allocCheckFrames(0),
+             profilerOverlay(textures.font), drawCalls(0), traceOnExit(false) {
+        worldView.reset(sf::FloatRect(0, 0, WIDTH, HEIGHT));
+        hudView.reset(sf::FloatRect(0, 0, WIDTH, HEIGHT));
 
         scoreText.setFont(textures.font);
         scoreText.setCharacterSize(28);
@@ -321,7 +198,7 @@ public:
         highScoreText.setFont(textures.font);
         highScoreText.setCharacterSize(28);
         highScoreText.setFillColor(sf::Color::Yellow);
-        highScoreText.setPosition(10, 40);
+        highScoreText.setPosition(10, 50);
         highScoreText.setOutlineColor(sf::Color::Black);
         highScoreText.setOutlineThickness(2.0f);
 
@@ -337,248 +214,874 @@ public:
         quitText.setString("Q to Quit!");
         quitText.setPosition(WIDTH / 2 - quitText.getGlobalBounds().width / 2, HEIGHT / 2 + 90);
 
+        menuText.setFont(textures.font);
+        menuText.setCharacterSize(20);
+        menuText.setFillColor(sf::Color::White);
+        menuText.setString("M for Menu");
+        menuText.setPosition(WIDTH / 2 - menuText.getGlobalBounds().width / 2, HEIGHT / 2 + 120);
+
         pauseText.setFont(textures.font);
         pauseText.setCharacterSize(30);
         pauseText.setFillColor(sf::Color::Yellow);
         pauseText.setString("Paused");
         pauseText.setPosition(WIDTH / 2 - pauseText.getGlobalBounds().width / 2, HEIGHT / 2);
 
+        pauseOverlay.setSize(sf::Vector2f(WIDTH, HEIGHT));
+        pauseOverlay.setFillColor(sf::Color(0, 0, 0, 128));
+
         finalScoreText.setFont(textures.font);
         finalScoreText.setCharacterSize(20);
         finalScoreText.setFillColor(sf::Color::White);
         finalScoreText.setPosition(WIDTH / 2 - finalScoreText.getGlobalBounds().width / 2, HEIGHT / 2 - 20);
 
-        srand(static_cast<unsigned>(time(0)));
-        platforms.emplace_back(WIDTH / 2 - 200, HEIGHT - 15, PlatformType::Normal, textures.platformTexture);
-        platforms.back().shape.setScale(400.0f / textures.platformTexture.getSize().x, 15.0f / textures.platformTexture.getSize().y);
-        platforms.back().shadow.setScale(400.0f / textures.platformTexture.getSize().x, 15.0f / textures.platformTexture.getSize().y);
-        platforms.back().scored = true;
-        for (int i = 0; i < PLATFORM_COUNT - 1; i++) {
-            float x = rand() % (WIDTH - 120);
-            float y = HEIGHT - 15 - (i + 1) * PLATFORM_SPACING;
-            platforms.emplace_back(x, y, PlatformType::Normal, textures.platformTexture);
-        }
+        standingsText.setFont(textures.font);
+        standingsText.setCharacterSize(18);
+        standingsText.setFillColor(sf::Color::White);
+        standingsText.setPosition(10, 90);
+        standingsText.setOutlineColor(sf::Color::Black);
+        standingsText.setOutlineThickness(1.5f);
+        shownStandings[0] = '\0';
+
+        platformRenderer.setKinds(sim.params);
+        pickupRenderer.setKinds(sim.params);
+        for (int k = 0; k < MAX_PICKUP_KINDS; k++) effectTints[k] = sf::Color(sim.params.pickupKinds[k].tint);
+
+        sim.tower.source = &towerWorker;
+        startRun();
+        prevPlayer = sim.player;
+        prevCameraY = sim.cameraY;
+        lastTickTime = std::chrono::steady_clock::now();
+        publishSnapshot();
     }
 
-    void updateBackground() {
-        if (score >= 150) {
-            currentLevel = 2;
-        } else if (score >= 100) {
-            currentLevel = 1;
-        } else {
-            currentLevel = 0;
+    ~Game() {
+        stopSimulation();
+    }
+
+    // Every run gets a fresh seed and is recorded so it can be replayed exactly.
+    void startRun() {
+        std::random_device rd;
+        std::uint64_t seed = (static_cast<std::uint64_t>(rd()) << 32) | rd();
+        towerWorker.restart(seed);
+        sim.reset(seed);
+        recorder.begin(seed, tickRate, sim.params);
+    }
+
+    // --autoplay: LookaheadBot plays instead of the keyboard, and a new run
+    // starts a few seconds after each fall. Half the cores search; the rest
+    // are left to the game's own threads.
+    void enableAutoplay() {
+        BotConfig config;
+        config.threads = std::max(1u, std::thread::hardware_concurrency() / 2);
+        autoplay.reset(new LookaheadBot(sim.params, config));
+    }
+
+    // Race mode: the server picks the seeds, so there is nothing to record.
+    bool connect(NetRole role, NetAddress server) {
+        race.reset(new RaceConnection(role, server));
+        if (!race->open()) return false;
+        sim.tower.source = nullptr;
+        if (role == ROLE_SPECTATOR) retryText.setString("Next race soon");
+        else retryText.setString("Waiting for the race");
+        retryText.setPosition(WIDTH / 2 - retryText.getGlobalBounds().width / 2, HEIGHT / 2 + 60);
+        return true;
+    }
+
+    void saveRecording() {
+        if (!recorder.active() || race) return;
+        std::error_code ec;
+        std::filesystem::create_directories("recordings", ec);
+        std::string path = "recordings/run-" + std::to_string(time(0)) + "-" +
+                           std::to_string(recorder.runSeed() % 100000) + ".icyrec";
+        if (!recorder.save(path, sim)) {
+            std::cerr << "Failed to write " << path << "." << std::endl;
         }
-        backgroundSprite.setTexture(textures.backgroundTextures[currentLevel]);
-        backgroundSprite.setScale(
-            static_cast<float>(WIDTH) / textures.backgroundTextures[currentLevel].getSize().x,
-            static_cast<float>(HEIGHT) / textures.backgroundTextures[currentLevel].getSize().y
+    }
+
+    // Called once the remaining textures have been uploaded.
+    void attachTextures() {
+        player.setTexture(textures.playerTexture);
+        ghost.setTexture(textures.playerTexture);
+        ghost.characterSprite.setColor(sf::Color(255, 255, 255, 110));
+        gameOverSprite.setTexture(textures.gameOverTexture, true);
+        gameOverSprite.setScale(
+            static_cast<float>(WIDTH) / gameOverSprite.getTexture()->getSize().x,
+            static_cast<float>(HEIGHT) / gameOverSprite.getTexture()->getSize().y
         );
+        gameOverSprite.setPosition(0, 0);
+        platformRenderer.invalidate();
+        background.setThemes(textures.backgroundTextures);
+    }
+
+    // Only on a change of level; the first theme shows at once, later ones
+    // crossfade in.
+    void updateBackground(int level) {
+        background.setTheme(level, shownLevel < 0);
+        shownLevel = level;
+    }
+
+    static float lerp(float a, float b, float t) {
+        return a + (b - a) * t;
     }
 
-    void spawnParticles(float x, float y, float size = 2.0f) {
-        for (int i = 0; i < 5; i++) {
-            particles.emplace_back(x, y, size);
+    // Draws the snapshot alpha of the way from its previous tick to its own.
+    // Scrolling is entirely the world view; nothing else moves with the camera.
+    void syncSprites(const FrameSnapshot& snapshot, float alpha) {
+        PlayerState p = snapshot.player;
+        p.pos.x = lerp(snapshot.prevPlayer.pos.x, snapshot.player.pos.x, alpha);
+        p.pos.y = lerp(snapshot.prevPlayer.pos.y, snapshot.player.pos.y, alpha);
+        player.sync(p);
+        platformRenderer.build(snapshot.platforms);
+        float cameraY = lerp(snapshot.prevCameraY, snapshot.cameraY, alpha);
+        worldView.setCenter(WIDTH / 2.0f, cameraY + HEIGHT / 2.0f);
+    }
+
+    // Simulation thread.
+    void tick(std::uint8_t input) {
+        prevPlayer = sim.player;
+        prevCameraY = sim.cameraY;
+        int previousScore = sim.score;
+        if (race) {
+            raceTick(input);
+        } else {
+            recorder.record(input);
+            sim.step(input, tickTime);
+        }
+        tickCount++;
+        for (int i = 0; i < sim.burstCount; i++) {
+            particles.emit(sim.bursts[i].x, sim.bursts[i].y, sim.bursts[i].size);
+        }
+        if (sim.score != previousScore) scorePulseTimer = 0.3f;
+        else if (scorePulseTimer > 0) scorePulseTimer -= tickTime;
+        if (sim.gameOver) {
+            highScore = std::max(sim.score, highScore);
+            saveRecording();
+        }
+        {
+            PROFILE_SCOPE(Phase::Background);
+            currentLevel = themeForScore(sim.score);
         }
+        {
+            PROFILE_SCOPE(Phase::Particles);
+            particles.update(tickTime);
+        }
+
+        backgroundOffset -= 2.0f * tickTime;
+        if (backgroundOffset <= -HEIGHT) backgroundOffset = 0;
     }
 
-    void handleCollisions() {
-        if (player.dy <= 0) return;
+    // Racers predict their own climb and let the client pace the local clock
+    // against the server; spectators follow whoever is in the lead.
+    void raceTick(std::uint8_t input) {
+        RaceClient& client = race->client;
+        if (client.role == ROLE_SPECTATOR) {
+            int leader = client.leader();
+            if (leader >= 0) restoreRacer(sim, client.seed, client.racers[leader]);
+        } else {
+            input |= carriedPress;
+            carriedPress = 0;
+            int steps = client.pace();
+            if (steps == 0) carriedPress = input & INPUT_JUMP_PRESSED;
+            for (int i = 0; i < steps; i++) {
+                client.step(sim, i == 0 ? input : input & ~INPUT_JUMP_PRESSED, tickTime);
+            }
+        }
+        race->send(sim);
+    }
 
-        for (auto& plat : platforms) {
-            if (!plat.active) continue;
-            sf::FloatRect playerBounds = player.getBounds();
-            sf::FloatRect platformBounds = plat.shape.getGlobalBounds();
+    // Simulation thread. A new race starts the run over on its seed.
+    void pollRace() {
+        if (!race->poll(sim)) return;
+        runCount++;
+        backgroundOffset = 0;
+        currentLevel = 0;
+        particles.clear();
+        prevPlayer = sim.player;
+        prevCameraY = sim.cameraY;
+        scorePulseTimer = 0.0f;
+        carriedPress = 0;
+    }
 
-            if (playerBounds.intersects(platformBounds)) {
-                if (player.dy > 0 && playerBounds.top + playerBounds.height >= platformBounds.top &&
-                    playerBounds.top + playerBounds.height <= platformBounds.top + 10) {
-                    player.dy = 0;
-                    player.characterSprite.setPosition(playerBounds.left, platformBounds.top - playerBounds.height);
-                    player.canJump = true;
-                    player.canDoubleJump = true;
-                    spawnParticles(playerBounds.left + playerBounds.width / 2, playerBounds.top + playerBounds.height, 3.0f);
+    // Simulation thread. Every slot was sized by earlier publishes, so this
+    // only copies.
+    void publishSnapshot() {
+        PROFILE_SCOPE(Phase::Snapshot);
+        FrameSnapshot& s = snapshots.back();
+        s.player = sim.player;
+        s.prevPlayer = prevPlayer;
+        s.cameraY = sim.cameraY;
+        s.prevCameraY = prevCameraY;
+        s.platforms = sim.platforms;
+        s.particles.copyFrom(particles);
+        s.score = sim.score;
+        s.highScore = highScore;
+        s.level = currentLevel;
+        s.gameOver = sim.gameOver;
+        s.scorePulseTimer = scorePulseTimer;
+        s.backgroundOffset = backgroundOffset;
+        s.run = runCount;
+        s.tick = tickCount;
+        s.tickTime = lastTickTime;
+        s.pressTime = lastPressTime;
+        for (int k = 0; k < MAX_PICKUP_KINDS; k++) {
+            bool timed = k < sim.params.pickupKindCount && sim.params.pickupKinds[k].duration > 0;
+            s.effectLeft[k] = timed ? sim.effectTime[k] / sim.params.pickupKinds[k].duration : 0;
+        }
+        s.racerCount = 0;
+        s.localRacer = -1;
+        if (race) {
+            const RaceClient& client = race->client;
+            s.racerCount = client.racerCount;
+            s.localRacer = client.role == ROLE_SPECTATOR ? client.leader() : client.localRacer;
+            for (int k = 0; k < client.racerCount; k++) {
+                const RacerState& r = client.racers[k];
+                s.racers[k] = {r.pos(), r.facingRight(), r.gameOver(), r.score()};
+            }
+        }
+        snapshots.publish();
+    }
 
-                    if (!plat.scored) {
-                        score += 10;
-                        plat.scored = true;
-                        scorePulseTimer = 0.3f;
-                    }
+    // Simulation thread: fixed-step ticks on their own clock, independent of
+    // the frame rate, with a snapshot after each batch. After a long stall
+    // the backlog is dropped instead of spiralling.
+    void simulate() {
+        using Clock = std::chrono::steady_clock;
+        const Clock::duration step =
+            std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(tickTime));
+        Clock::time_point due = Clock::now() + step;
+        while (simRunning.load(std::memory_order_relaxed)) {
+            if (resetRequested.exchange(false, std::memory_order_acquire)) {
+                reset();
+                lastTickTime = Clock::now();
+                due = lastTickTime + step;
+                publishSnapshot();
+            }
+            if (race) pollRace();
+            Clock::time_point now = Clock::now();
+            // In a race the clock keeps running after a fall to stay in touch
+            // with the server.
+            if ((sim.gameOver && !race) || paused.load(std::memory_order_relaxed)) {
+                // Keep held keys current, but presses made now do not jump later.
+                InputClock::time_point ignored;
+                inputSampler.sample(inputQueue, now);
+                inputSampler.takePress(ignored);
+                if (autoplay && sim.gameOver && !race && now - lastTickTime > AUTOPLAY_RESTART_DELAY) {
+                    resetRequested.store(true, std::memory_order_release);
+                }
+                due = now + step;
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+                continue;
+            }
+            if (now < due) {
+                std::this_thread::sleep_until(due);
+                continue;
+            }
+            int steps = 0;
+            while (due <= now && steps < MAX_STEPS_PER_FRAME && (!sim.gameOver || race)) {
+                // Catch-up ticks see the events up to their own due time; the
+                // latest tick samples as late as possible.
+                bool latest = due + step > now || steps + 1 == MAX_STEPS_PER_FRAME;
+                std::uint8_t input = inputSampler.sample(inputQueue, latest ? Clock::now() : due);
+                inputSampler.takePress(lastPressTime);
+                if (autoplay) {
+                    PROFILE_SCOPE(Phase::Bot);
+                    input = autoplay->input(sim, tickTime);
                 }
+                tick(input);
+                lastTickTime = due;
+                due += step;
+                steps++;
             }
+            if (due <= now) due = now + step;
+            publishSnapshot();
         }
+        saveRecording();
+        if (race) race->leave();
     }
 
-    void updateCamera(float deltaTime) {
-        sf::FloatRect playerBounds = player.getBounds();
-        float targetCameraY = playerBounds.top - HEIGHT / 2;
-        if (targetCameraY > 0) targetCameraY = 0;
-        cameraY += (targetCameraY - cameraY) * 5.0f * deltaTime;
-
-        player.characterSprite.move(0, -cameraY);
-        for (auto& plat : platforms) {
-            plat.shape.move(0, -cameraY);
-            plat.shadow.move(0, -cameraY);
-            if (plat.shape.getPosition().y > HEIGHT) {
-                float x = rand() % (WIDTH - 120);
-                float minY = -15;
-                for (const auto& p : platforms) {
-                    if (p.shape.getPosition().y < 0 && p.shape.getPosition().y > minY) {
-                        minY = p.shape.getPosition().y;
-                    }
+    void startSimulation() {
+        simRunning.store(true, std::memory_order_relaxed);
+        simThread = std::thread([this] { simulate(); });
+    }
+
+    void stopSimulation() {
+        if (!simThread.joinable()) return;
+        simRunning.store(false, std::memory_order_relaxed);
+        simThread.join();
+    }
+
+    // Render thread. Movement keys are stamped and queued for the simulation
+    // thread instead of being polled at tick time, so a tap shorter than a
+    // tick still registers.
+    void pumpEvents() {
+        PROFILE_SCOPE(Phase::Events);
+        sf::Event e;
+        while (window.pollEvent(e)) {
+            InputClock::time_point now = InputClock::now();
+            if (e.type == sf::Event::Closed) closeWindow();
+            if (e.type == sf::Event::LostFocus) {
+                inputQueue.push({now, INPUT_LEFT | INPUT_RIGHT | INPUT_JUMP, false});
+            }
+            if (e.type == sf::Event::KeyReleased && inputBits(e.key.code)) {
+                inputQueue.push({now, inputBits(e.key.code), false});
+            }
+            if (e.type == sf::Event::KeyPressed) {
+                // Keys pressed on the menu are not held over into the game.
+                if (inputBits(e.key.code) && scenes.top() != Scene::Menu) {
+                    inputQueue.push({now, inputBits(e.key.code), true});
                 }
-                float newY = minY - PLATFORM_SPACING;
-                plat.shape.setPosition(x, newY);
-                plat.shadow.setPosition(x + 5, newY + 5);
-                plat.active = true;
-                plat.scored = false;
-                plat.shape.setColor(sf::Color::White);
-                plat.shadow.setColor(sf::Color(0, 0, 0, 100));
+                sceneKey(e.key.code);
+                if (e.key.code == sf::Keyboard::F5) toggleCapture();
+                if (e.key.code == sf::Keyboard::F3) {
+                    profilerOverlay.visible = !profilerOverlay.visible;
+                    if (profilerOverlay.visible) Profiler::instance().setEnabled(true);
+                }
+                if (e.key.code == sf::Keyboard::F4 && Profiler::instance().enabled()) dumpTrace();
             }
         }
+    }
 
-        highestY = std::min(highestY, playerBounds.top);
+    // Render thread: the keys that move between scenes.
+    void sceneKey(sf::Keyboard::Key key) {
+        switch (scenes.top()) {
+            case Scene::Menu: {
+                Menu::Choice choice = menu.keyPressed(key);
+                if (choice == Menu::Play) play();
+                if (choice == Menu::Exit) closeWindow();
+                break;
+            }
+            case Scene::Playing:
+                if (key == sf::Keyboard::P && !race) {
+                    paused.store(true, std::memory_order_relaxed);
+                    scenes.push(Scene::Paused);
+                }
+                break;
+            case Scene::Paused:
+                if (key == sf::Keyboard::P) {
+                    paused.store(false, std::memory_order_relaxed);
+                    scenes.pop();
+                }
+                break;
+            case Scene::GameOver:
+                if (key == sf::Keyboard::R && !race) resetRequested.store(true, std::memory_order_release);
+                if (key == sf::Keyboard::M && !race) showMenu();
+                if (key == sf::Keyboard::Q) closeWindow();
+                break;
+        }
     }
 
-    void updateText() {
-        std::stringstream ss;
-        ss << "Score: " << score;
-        scoreText.setString(ss.str());
-        ss.str("");
-        ss << "High Score: " << highScore;
-        highScoreText.setString(ss.str());
-        if (scorePulseTimer > 0) {
-            float scale = 1.0f + 0.25f * std::sin(scorePulseTimer * 10.0f);
+    // Render thread. The remaining textures are usually uploaded by now, and
+    // the simulation thread starts on the first Play; after that it was only
+    // held while the menu was up.
+    void play() {
+        textures.finishLoading();
+        attachTextures();
+        scenes.reset(Scene::Playing);
+        paused.store(false, std::memory_order_relaxed);
+        if (!simThread.joinable()) startSimulation();
+    }
+
+    // Render thread: from game over back to the menu. The simulation is held
+    // there with a fresh run ready for the next Play.
+    void showMenu() {
+        paused.store(true, std::memory_order_relaxed);
+        resetRequested.store(true, std::memory_order_release);
+        scenes.reset(Scene::Menu);
+    }
+
+    // Render thread: the game-over screen comes and goes with the run.
+    void followRun(const FrameSnapshot& snapshot) {
+        if (scenes.top() == Scene::Playing && snapshot.gameOver) scenes.push(Scene::GameOver);
+        else if (scenes.top() == Scene::GameOver && !snapshot.gameOver) scenes.pop();
+    }
+
+    // Frame cap that keeps handling events while it waits, rather than
+    // sleeping inside display() like setFramerateLimit.
+    // Uncapped play still idles at IDLE_FRAME_RATE outside the game itself.
+    void waitForNextFrame() {
+        int rate = frameRate > 0 ? frameRate : scenes.top() == Scene::Playing ? 0 : IDLE_FRAME_RATE;
+        if (rate <= 0) return;
+        const InputClock::duration frame = std::chrono::duration_cast<InputClock::duration>(
+            std::chrono::duration<double>(1.0 / rate));
+        nextFrameTime += frame;
+        InputClock::time_point now = InputClock::now();
+        if (nextFrameTime < now) nextFrameTime = now;
+        while (now < nextFrameTime && window.isOpen()) {
+            pumpEvents();
+            std::this_thread::sleep_for(std::min<InputClock::duration>(nextFrameTime - now, std::chrono::milliseconds(1)));
+            now = InputClock::now();
+        }
+    }
+
+    // --latency: report how long key presses take to reach the screen.
+    void enableLatencyCheck() {
+        measureLatency = true;
+    }
+
+    // Strings are only rebuilt when the numbers change; SFML regenerates glyph
+    // geometry on every setString.
+    void updateText(const FrameSnapshot& snapshot) {
+        char buffer[64];
+        if (snapshot.score != shownScore || snapshot.highScore != shownHighScore) {
+            shownScore = snapshot.score;
+            shownHighScore = snapshot.highScore;
+            std::snprintf(buffer, sizeof(buffer), "Score: %d", shownScore);
+            scoreText.setString(buffer);
+            std::snprintf(buffer, sizeof(buffer), "High Score: %d", shownHighScore);
+            highScoreText.setString(buffer);
+            std::snprintf(buffer, sizeof(buffer), "Final Score: %d\nBest: %d", shownScore, shownHighScore);
+            finalScoreText.setString(buffer);
+            finalScoreText.setPosition(WIDTH / 2 - finalScoreText.getGlobalBounds().width / 2, HEIGHT / 2 - 50);
+        }
+        if (snapshot.scorePulseTimer > 0) {
+            float scale = 1.0f + 0.25f * std::sin(snapshot.scorePulseTimer * 10.0f);
             scoreText.setScale(scale, scale);
-            scorePulseTimer -= 0.016f;
         } else {
             scoreText.setScale(1.0f, 1.0f);
         }
-        scoreText.setPosition(10, 10 - cameraY);
-        highScoreText.setPosition(10, 50 - cameraY);
+        if (snapshot.racerCount > 0) {
+            char standings[sizeof(shownStandings)];
+            int used = 0;
+            standings[0] = '\0';
+            for (int k = 0; k < snapshot.racerCount; k++) {
+                const RacerView& r = snapshot.racers[k];
+                used += std::snprintf(standings + used, sizeof(standings) - used, "P%d  %d%s%s\n", k + 1, r.score,
+                                      r.gameOver ? "  out" : "", k == snapshot.localRacer ? "  <" : "");
+                used = std::min(used, static_cast<int>(sizeof(standings)) - 1);
+            }
+            if (std::strcmp(standings, shownStandings) != 0) {
+                std::memcpy(shownStandings, standings, sizeof(standings));
+                standingsText.setString(standings);
+            }
+        }
+    }
+
+    // --profile: record from the first frame and write a trace on exit.
+    void enableProfiler() {
+        Profiler::instance().setEnabled(true);
+        profilerOverlay.visible = true;
+        traceOnExit = true;
+    }
+
+    void dumpTrace() {
+        std::string path = "trace-" + std::to_string(time(0)) + ".json";
+        if (Profiler::instance().writeChromeTrace(path)) std::cout << "Wrote " << path << std::endl;
+        else std::cerr << "Failed to write " << path << "." << std::endl;
+    }
 
-        ss.str("");
-        ss << "Final Score: " << score << "\nBest: " << highScore;
-        finalScoreText.setString(ss.str());
-        finalScoreText.setPosition(WIDTH / 2 - finalScoreText.getGlobalBounds().width / 2, HEIGHT / 2 - 50);
+    void draw(const sf::Drawable& drawable) {
+        screen.target().draw(drawable);
+        drawCalls++;
     }
 
-    void checkGameOver() {
-        if (player.getBounds().top > HEIGHT) {
-            gameOver = true;
-            highScore = std::max(score, highScore);
+    // --render-scale, --scaling, --dynamic-resolution and --fullscreen. A
+    // window is the logical size times the render scale; fullscreen takes
+    // the desktop's resolution and letterboxes.
+    void configureDisplay(unsigned scale, bool integer, bool dynamic, bool full) {
+        renderScale = scale;
+        integerScaling = integer;
+        dynamicResolution = dynamic;
+        fullscreen = full;
+        resolution.setBudget(1000.0f / (frameRate > 0 ? frameRate : 60));
+    }
+
+    bool openWindow(bool allowFullscreen) {
+        if (fullscreen && allowFullscreen) {
+            window.create(sf::VideoMode::getDesktopMode(), "Icy Tower", sf::Style::Fullscreen);
+        } else {
+            window.create(sf::VideoMode(WIDTH * renderScale, HEIGHT * renderScale), "Icy Tower");
         }
+        window.setVerticalSyncEnabled(false);
+        if (!screen.create(renderScale)) {
+            std::cerr << "Failed to create a " << WIDTH * renderScale << "x" << HEIGHT * renderScale
+                      << " render texture." << std::endl;
+            window.close();
+            return false;
+        }
+        return true;
+    }
+
+    // Counts heap allocations per frame after a warm-up and reports any
+    // frame that allocated. Needs a -DICY_TRACK_ALLOCS build.
+    void enableAllocCheck(int frames) {
+        allocCheckFrames = frames;
     }
 
+    // Simulation thread, on request from the render thread.
     void reset() {
-        player.reset(WIDTH / 2, HEIGHT - 100);
-        cameraY = 0;
-        highestY = HEIGHT - 100;
-        score = 0;
+        startRun();
+        runCount++;
         backgroundOffset = 0;
         currentLevel = 0;
-        updateBackground();
-        platforms.clear();
         particles.clear();
-        platforms.emplace_back(WIDTH / 2 - 200, HEIGHT - 15, PlatformType::Normal, textures.platformTexture);
-        platforms.back().shape.setScale(400.0f / textures.platformTexture.getSize().x, 15.0f / textures.platformTexture.getSize().y);
-        platforms.back().shadow.setScale(400.0f / textures.platformTexture.getSize().x, 15.0f / textures.platformTexture.getSize().y);
-        platforms.back().scored = true;
-        for (int i = 0; i < PLATFORM_COUNT - 1; i++) {
-            float x = rand() % (WIDTH - 120);
-            float y = HEIGHT - 15 - (i + 1) * PLATFORM_SPACING;
-            platforms.emplace_back(x, y, PlatformType::Normal, textures.platformTexture);
-        }
-        gameOver = false;
-        paused = false;
+        prevPlayer = sim.player;
+        prevCameraY = sim.cameraY;
         scorePulseTimer = 0.0f;
     }
 
-    void run() {
-        Menu menu(textures.font, textures.backgroundTextures[0]);
-        if (!menu.run()) return;
-        menu.window.close();
+    // The capture needs the window's GL context to finish.
+    void closeWindow() {
+        capture.stop();
+        window.close();
+    }
 
-        window.create(sf::VideoMode(WIDTH, HEIGHT), "Icy Tower");
-        window.setFramerateLimit(60);
-        window.setVerticalSyncEnabled(false);
+    // --capture=PATH: record from the first frame.
+    void enableCapture(const std::string& path) {
+        capturePath = path;
+    }
 
-        sf::Clock clock;
-        while (window.isOpen()) {
-            float deltaTime = clock.restart().asSeconds();
-
-            sf::Event e;
-            while (window.pollEvent(e)) {
-                if (e.type == sf::Event::Closed) window.close();
-                if (e.type == sf::Event::KeyPressed) {
-                    if (e.key.code == sf::Keyboard::P && !gameOver) {
-                        paused = !paused;
-                    }
-                    if (e.key.code == sf::Keyboard::R && gameOver) reset();
-                    if (e.key.code == sf::Keyboard::Q && gameOver) window.close();
+    // F5: start or stop capturing to captures/.
+    void toggleCapture() {
+        if (capture.active()) {
+            capture.stop();
+            return;
+        }
+        startCapture("captures/capture-" + std::to_string(time(0)) + ".y4m", false);
+    }
+
+    // Frames are stamped at the frame cap's rate, or the tick rate without
+    // one. They come from the screen texture, whose size does not follow
+    // the window's, drawn in full: dynamic resolution waits until the end.
+    void startCapture(const std::string& path, bool wait) {
+        sf::Vector2u size = screen.size();
+        resolution.reset();
+        screen.setShare(1);
+        capture.start(path, size.x, size.y, frameRate > 0 ? frameRate : tickRate, wait);
+    }
+
+    // Render thread, after drawFrame() and before display().
+    void grabFrame() {
+        if (!capture.active()) return;
+        screen.target().setActive(true);
+        capture.grab();
+        window.setActive(true);
+    }
+
+    // Render thread: everything up to display(). Scenes are drawn bottom-up
+    // from the topmost one that covers the window, into the screen texture,
+    // which is then upscaled onto the window.
+    void drawFrame(const FrameSnapshot& snapshot, float alpha, float frameTime) {
+        sf::RenderTarget& target = screen.target();
+        screen.fit(worldView);
+        screen.fit(hudView);
+        int first = scenes.firstVisible();
+        bool world = scenes[first] == Scene::Playing;
+        if (world) {
+            if (snapshot.run != shownRun) {
+                shownRun = snapshot.run;
+                platformRenderer.invalidate();
+            }
+            if (snapshot.level != shownLevel) updateBackground(snapshot.level);
+            syncSprites(snapshot, alpha);
+            background.update(frameTime, snapshot.backgroundOffset, worldView.getCenter().y - HEIGHT / 2.0f);
+        }
+        {
+            PROFILE_SCOPE(Phase::Text);
+            if (world) updateText(snapshot);
+            if (profilerOverlay.visible) profilerOverlay.update(frameTime);
+        }
+        {
+            PROFILE_SCOPE(Phase::Draw);
+            drawCalls = 0;
+            target.clear();
+            for (int i = first; i < scenes.size(); i++) {
+                target.setView(hudView);
+                switch (scenes[i]) {
+                    case Scene::Menu:
+                        drawCalls += menu.draw(target);
+                        break;
+                    case Scene::Playing:
+                        drawWorld(snapshot);
+                        break;
+                    case Scene::Paused:
+                        draw(pauseOverlay);
+                        draw(pauseText);
+                        break;
+                    case Scene::GameOver:
+                        draw(gameOverSprite);
+                        draw(finalScoreText);
+                        draw(retryText);
+                        draw(quitText);
+                        if (!race) draw(menuText);
+                        break;
                 }
             }
+            target.setView(hudView);
+            if (profilerOverlay.visible) drawCalls += profilerOverlay.draw(target);
+            screen.present(window, integerScaling);
+            drawCalls++;
+        }
+    }
 
-            if (!gameOver && !paused) {
-                player.handleInput();
-                player.checkWallJump();
-                player.update(deltaTime);
-                player.handleWallCollision();
-                for (auto& plat : platforms) plat.update(deltaTime);
-                handleCollisions();
-                updateCamera(deltaTime);
-                updateBackground();
-
-                for (auto it = particles.begin(); it != particles.end();) {
-                    if (it->update(deltaTime)) it = particles.erase(it);
-                    else ++it;
-                }
+    // The Playing scene: background, tower, racers and the HUD.
+    void drawWorld(const FrameSnapshot& snapshot) {
+        sf::RenderTarget& target = screen.target();
+        drawCalls += background.draw(target);
 
-                backgroundOffset -= 2.0f * deltaTime;
-                if (backgroundOffset <= -HEIGHT) backgroundOffset = 0;
-            }
+        target.setView(worldView);
+        platformRenderer.draw(target);
+        drawCalls++;
+        pickupRenderer.build(snapshot.platforms);
+        draw(pickupRenderer.vertices);
+        particleRenderer.build(snapshot.particles);
+        draw(particleRenderer.vertices);
+        for (int k = 0; k < snapshot.racerCount; k++) {
+            if (k == snapshot.localRacer) continue;
+            PlayerState state;
+            state.pos = snapshot.racers[k].pos;
+            state.facingRight = snapshot.racers[k].facingRight;
+            ghost.sync(state);
+            draw(ghost.characterSprite);
+        }
+        draw(player.characterSprite);
 
-            checkGameOver();
-            updateText();
-            window.clear();
-            backgroundSprite.setPosition(0, backgroundOffset);
-            window.draw(backgroundSprite);
-            if (backgroundOffset <= 0) {
-                backgroundSprite.setPosition(0, backgroundOffset + HEIGHT);
-                window.draw(backgroundSprite);
-            }
+        target.setView(hudView);
+        draw(scoreText);
+        draw(highScoreText);
+        if (snapshot.racerCount > 0) draw(standingsText);
+        // Active power-ups as shrinking bars in their tint.
+        for (int k = 0; k < MAX_PICKUP_KINDS; k++) {
+            if (snapshot.effectLeft[k] <= 0) continue;
+            effectBar.setSize(sf::Vector2f(100 * snapshot.effectLeft[k], 8));
+            effectBar.setPosition(WIDTH - 110, 14 + 14 * k);
+            effectBar.setFillColor(effectTints[k]);
+            draw(effectBar);
+        }
+    }
+
+    // --render-replay: every tick of a recording drawn once and captured, as
+    // fast as the encoders keep up, with no simulation thread. Fails if the
+    // recording does not reproduce.
+    int renderReplay(const Replay& replay, const std::string& path) {
+        textures.finishLoading();
+        attachTextures();
+        if (!openWindow(false)) return 1;
 
-            for (const auto& plat : platforms) {
-                if (plat.active) {
-                    window.draw(plat.shadow);
-                    window.draw(plat.shape);
+        // A playback is not a new run; saving it would write a recording
+        // under the seed startRun() picked, with the replay's inputs.
+        recorder.stop();
+        towerWorker.restart(replay.seed);
+        sim.reset(replay.seed);
+        prevPlayer = sim.player;
+        prevCameraY = sim.cameraY;
+        scenes.reset(Scene::Playing);
+        startCapture(path, true);
+        for (std::size_t i = 0; i < replay.runLengths.size() && window.isOpen(); i++) {
+            for (std::uint64_t t = 0; t < replay.runLengths[i] && !sim.gameOver && window.isOpen(); t++) {
+                tick(replay.runInputs[i]);
+                publishSnapshot();
+                snapshots.acquire();
+                followRun(snapshots.front());
+                drawFrame(snapshots.front(), 1.0f, tickTime);
+                grabFrame();
+                window.display();
+                sf::Event e;
+                while (window.pollEvent(e)) {
+                    if (e.type == sf::Event::Closed) closeWindow();
                 }
             }
-            for (const auto& particle : particles) window.draw(particle.shape);
-            window.draw(player.characterSprite);
-            window.draw(scoreText);
-            window.draw(highScoreText);
-            if (paused) {
-                sf::RectangleShape overlay(sf::Vector2f(WIDTH, HEIGHT));
-                overlay.setFillColor(sf::Color(0, 0, 0, 128));
-                window.draw(overlay);
-                window.draw(pauseText);
+        }
+        if (window.isOpen()) closeWindow();
+        if (!(ReplaySummary::of(sim) == replay.expected)) {
+            std::cerr << "The recording did not reproduce; the capture may not match the run." << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    // One window for every scene, so textures and the font are uploaded once
+    // and moving between the menu and the game is only a change of scene.
+    int run() {
+        if (!openWindow(true)) return 1;
+        window.setKeyRepeatEnabled(false);
+
+        const int allocWarmupFrames = 120;
+        int frame = 0;
+        int allocatingFrames = 0;
+        std::uint64_t worstFrameAllocs = 0;
+
+        if (!capturePath.empty()) startCapture(capturePath, false);
+        if (allocCheckFrames > 0) play();
+        nextFrameTime = InputClock::now();
+        sf::Clock clock;
+        while (window.isOpen()) {
+            PROFILE_SCOPE(Phase::Frame);
+            std::uint64_t allocsBefore = AllocTracker::count();
+            float frameTime = clock.restart().asSeconds();
+            snapshots.acquire();
+            const FrameSnapshot& snapshot = snapshots.front();
+
+            pumpEvents();
+            if (scenes.top() == Scene::Menu) textures.uploadReady();
+            followRun(snapshot);
+
+            float alpha = 1.0f;
+            if (!snapshot.gameOver) {
+                float sinceTick = std::chrono::duration<float>(std::chrono::steady_clock::now() - snapshot.tickTime).count();
+                alpha = std::min(std::max(sinceTick / tickTime, 0.0f), 1.0f);
+            }
+            drawFrame(snapshot, alpha, frameTime);
+            grabFrame();
+            {
+                PROFILE_SCOPE(Phase::Display);
+                window.display();
             }
-            if (gameOver) {
-                gameOverSprite.setPosition(0, 0);
-                retryText.setPosition(WIDTH / 2 - retryText.getGlobalBounds().width / 2, HEIGHT / 2 + 60);
-                quitText.setPosition(WIDTH / 2 - quitText.getGlobalBounds().width / 2, HEIGHT / 2 + 90);
-                window.draw(gameOverSprite);
-                window.draw(finalScoreText);
-                window.draw(retryText);
-                window.draw(quitText);
+            // The clock restarted at the top of the frame, so this is the
+            // frame's work without the wait for the next one.
+            if (dynamicResolution && !capture.active() && resolution.addFrame(clock.getElapsedTime().asSeconds() * 1000.0f)) {
+                screen.setShare(resolution.share());
             }
-            window.display();
+            if (measureLatency && snapshot.pressTime != shownPressTime) {
+                shownPressTime = snapshot.pressTime;
+                latency.add(std::chrono::duration<float, std::milli>(InputClock::now() - shownPressTime).count());
+            }
+            if (Profiler::instance().enabled()) {
+                Profiler::instance().endFrame(frameTime * 1000.0f, drawCalls, snapshot.particles.count);
+            }
+
+            if (allocCheckFrames > 0 && ++frame > allocWarmupFrames) {
+                std::uint64_t allocs = AllocTracker::count() - allocsBefore;
+                if (allocs > 0) {
+                    allocatingFrames++;
+                    worstFrameAllocs = std::max(worstFrameAllocs, allocs);
+                }
+                if (frame == allocWarmupFrames + allocCheckFrames) closeWindow();
+            }
+            waitForNextFrame();
+        }
+
+        // The simulation thread saves the run's recording on its way out.
+        stopSimulation();
+        capture.stop();
+        if (traceOnExit) dumpTrace();
+        if (measureLatency) latency.report(std::cout);
+
+        if (allocCheckFrames > 0) {
+            std::cout << allocatingFrames << " of " << allocCheckFrames << " steady-state frames allocated"
+                      << " (worst frame: " << worstFrameAllocs << " allocations)" << std::endl;
+            return allocatingFrames == 0 ? 0 : 1;
         }
+        return 0;
     }
 };
 
-int main() {
-    Game game;
-    game.run();
-    return 0;
+int main(int argc, char** argv) {
+    int tickRate = TICK_RATE;
+    int frameRate = 60;
+    int allocCheckFrames = 0;
+    bool profile = false;
+    bool measureLatency = false;
+    bool autoplay = false;
+    NetRole netRole = ROLE_RACER;
+    std::string endpoint;
+    std::string contentPath = "platforms.cfg";
+    bool contentRequired = false;
+    std::string capturePath;
+    std::string replayPath;
+    int renderScale = 1;
+    bool integerScaling = true;
+    bool dynamicResolution = false;
+    bool fullscreen = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.rfind("--replay=", 0) == 0) {
+            // Headless: no window, no assets.
+            std::string message;
+            std::uint64_t ticks;
+            if (!verifyReplay(arg.substr(9), message, ticks)) {
+                std::cerr << message << std::endl;
+                return 1;
+            }
+            std::cout << arg.substr(9) << ": OK (" << ticks << " ticks)" << std::endl;
+            return 0;
+        } else if (arg.rfind("--tick-rate=", 0) == 0) {
+            tickRate = std::atoi(arg.c_str() + 12);
+        } else if (arg.rfind("--fps=", 0) == 0) {
+            frameRate = std::max(0, std::atoi(arg.c_str() + 6));
+        } else if (arg.rfind("--connect=", 0) == 0) {
+            netRole = ROLE_RACER;
+            endpoint = arg.substr(10);
+        } else if (arg.rfind("--spectate=", 0) == 0) {
+            netRole = ROLE_SPECTATOR;
+            endpoint = arg.substr(11);
+        } else if (arg.rfind("--capture=", 0) == 0) {
+            capturePath = arg.substr(10);
+        } else if (arg.rfind("--render-replay=", 0) == 0) {
+            replayPath = arg.substr(16);
+        } else if (arg.rfind("--content=", 0) == 0) {
+            contentPath = arg.substr(10);
+            contentRequired = true;
+        } else if (arg == "--profile") {
+            profile = true;
+        } else if (arg == "--latency") {
+            measureLatency = true;
+        } else if (arg == "--autoplay") {
+            autoplay = true;
+        } else if (arg.rfind("--render-scale=", 0) == 0) {
+            renderScale = std::atoi(arg.c_str() + 15);
+        } else if (arg == "--scaling=integer" || arg == "--scaling=nearest") {
+            integerScaling = arg == "--scaling=integer";
+        } else if (arg == "--dynamic-resolution") {
+            dynamicResolution = true;
+        } else if (arg == "--fullscreen") {
+            fullscreen = true;
+        } else if (arg == "--alloc-check") {
+            allocCheckFrames = 600;
+        } else {
+            std::cerr << "Unknown argument " << arg << "." << std::endl;
+            return 1;
+        }
+    }
+    if (tickRate <= 0) {
+        std::cerr << "Tick rate must be positive." << std::endl;
+        return 1;
+    }
+    if (renderScale < 1 || renderScale > 8) {
+        std::cerr << "Render scale must be between 1 and 8." << std::endl;
+        return 1;
+    }
+    if (allocCheckFrames > 0 && !AllocTracker::enabled()) {
+        std::cerr << "--alloc-check needs a build with -DICY_TRACK_ALLOCS (make alloc-check)." << std::endl;
+        return 1;
+    }
+    NetAddress server = 0;
+    if (!endpoint.empty() && !parseEndpoint(endpoint, server)) {
+        std::cerr << "Cannot resolve " << endpoint << "." << std::endl;
+        return 1;
+    }
+    // Without platforms.cfg the tower is plain platforms only.
+    SimParams params;
+    std::error_code ec;
+    if (contentRequired || std::filesystem::exists(contentPath, ec)) {
+        std::string error;
+        if (!loadContent(contentPath, params, error)) {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+    }
+    if (!replayPath.empty()) {
+        // The recording brings its own rules and tick rate.
+        Replay replay;
+        std::string error;
+        if (!replay.load(replayPath, error)) {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+        if (capturePath.empty()) capturePath = "captures/" + std::filesystem::path(replayPath).stem().string() + ".y4m";
+        Game game(replay.params, replay.tickRate, 0);
+        game.configureDisplay(renderScale, true, false, false);
+        return game.renderReplay(replay, capturePath);
+    }
+    Game game(params, tickRate, frameRate);
+    game.configureDisplay(renderScale, integerScaling, dynamicResolution, fullscreen);
+    game.enableAllocCheck(allocCheckFrames);
+    if (profile) game.enableProfiler();
+    if (measureLatency) game.enableLatencyCheck();
+    if (autoplay) game.enableAutoplay();
+    if (!capturePath.empty()) game.enableCapture(capturePath);
+    if (!endpoint.empty() && !game.connect(netRole, server)) {
+        std::cerr << "Failed to open a UDP socket." << std::endl;
+        return 1;
+    }
+    return game.run();
 }
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "sim.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+using InputClock = std::chrono::steady_clock;
+
+// A key going down or up, stamped when the window event was polled.
+struct InputEvent {
+    InputClock::time_point time;
+    std::uint8_t bits;
+    bool pressed;
+};
+
+const int INPUT_QUEUE_SIZE = 256;
+
+// Carries key events from the window thread to the simulation thread: a
+// single-producer/single-consumer ring. When full new events are dropped.
+class InputQueue {
+public:
+    bool push(const InputEvent& event) {
+        std::uint32_t head = writePos.load(std::memory_order_relaxed);
+        if (head - readPos.load(std::memory_order_acquire) == INPUT_QUEUE_SIZE) return false;
+        ring[head % INPUT_QUEUE_SIZE] = event;
+        writePos.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // The oldest event, if it happened at or before cutoff.
+    bool pop(InputClock::time_point cutoff, InputEvent& out) {
+        std::uint32_t tail = readPos.load(std::memory_order_relaxed);
+        if (tail == writePos.load(std::memory_order_acquire)) return false;
+        const InputEvent& event = ring[tail % INPUT_QUEUE_SIZE];
+        if (event.time > cutoff) return false;
+        out = event;
+        readPos.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    InputEvent ring[INPUT_QUEUE_SIZE];
+    std::atomic<std::uint32_t> writePos{0};
+    std::atomic<std::uint32_t> readPos{0};
+};
+
+// Folds queued key events into one InputBits mask per tick. Held keys carry
+// over from tick to tick; a Space press sets INPUT_JUMP_PRESSED for the next
+// tick even if the key was released again before it ran.
+class InputSampler {
+public:
+    std::uint8_t held = 0;
+
+    // Input for the tick about to run, from every event up to cutoff.
+    std::uint8_t sample(InputQueue& queue, InputClock::time_point cutoff) {
+        std::uint8_t pressed = 0;
+        InputEvent event;
+        while (queue.pop(cutoff, event)) {
+            if (!event.pressed) {
+                held &= ~event.bits;
+                continue;
+            }
+            if (event.bits & ~held) {
+                if (!hasPress) pressTime = event.time;
+                hasPress = true;
+            }
+            if ((event.bits & INPUT_JUMP) && !(held & INPUT_JUMP)) pressed |= INPUT_JUMP_PRESSED;
+            held |= event.bits;
+        }
+        return held | pressed;
+    }
+
+    // Time of the first key press sampled since the last call.
+    bool takePress(InputClock::time_point& out) {
+        if (!hasPress) return false;
+        out = pressTime;
+        hasPress = false;
+        return true;
+    }
+
+private:
+    InputClock::time_point pressTime;
+    bool hasPress = false;
+};
+
+// Input-to-present latencies in milliseconds, reported as percentiles.
+class LatencyStats {
+public:
+    explicit LatencyStats(int capacity = 4096) { samples.reserve(capacity); }
+
+    void add(float ms) {
+        if (samples.size() < samples.capacity()) samples.push_back(ms);
+    }
+
+    void report(std::ostream& out) {
+        if (samples.empty()) {
+            out << "No key presses were presented." << std::endl;
+            return;
+        }
+        std::sort(samples.begin(), samples.end());
+        auto at = [&](int percent) { return samples[(samples.size() - 1) * percent / 100]; };
+        out << "Input-to-present latency over " << samples.size() << " presses: p50 " << at(50)
+            << " ms, p90 " << at(90) << " ms, p99 " << at(99) << " ms, max " << samples.back() << " ms"
+            << std::endl;
+    }
+
+private:
+    std::vector<float> samples;
+};
@@ -0,0 +1,673 @@
+#pragma once
+
+#include "sim.h"
+#include "replay.h"
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+// Race mode protocol. Every racer runs their own Simulation of the same
+// seeded tower; the server steps all of them authoritatively and streams
+// their state to racers and spectators. Transport-agnostic: RaceServer and
+// RaceClient take and produce datagrams, net_socket.h moves them over UDP.
+//
+// Datagrams, little-endian, first byte is the NetMessage:
+//   JOIN      u8 protocol, u8 role
+//   WELCOME   u8 protocol, u16 tick rate, SimParams, u8 racers per race
+//   INPUT     u32 race, u32 ack tick, u32 first tick, u8 count, u8 input bits[count]
+//   ACK       u32 race, u32 ack tick (spectators; also the keep-alive)
+//   SNAPSHOT  u32 race, u64 seed, u32 tick, u32 baseline tick, u8 your racer,
+//             u8 racer count, then per racer: u8 flags, delta-coded RacerState
+//   LEAVE
+// Snapshots are delta-coded against the newest one the client acknowledged,
+// so a lost packet only costs the next snapshot a few bytes.
+const std::uint16_t NET_PORT = 47123;
+// Version 2: SimParams carry the platform kinds and pickups.
+// Version 3: landings are swept along the tick's fall.
+// Version 4: the camera's scroll is scaled to the tick rate.
+// Version 5: towers place platforms anywhere a jump's fall crosses.
+// Version 6: gravity is integrated exactly; landings and the camera are
+// resolved within the tick.
+const std::uint8_t NET_PROTOCOL = 6;
+const int MAX_RACERS = 8;
+// Ticks of inputs and snapshots kept on both sides for deltas and resends.
+const int NET_HISTORY = 64;
+// How long the server waits for a racer's input before repeating the last.
+const int MAX_INPUT_LAG = 12;
+const int INPUT_REDUNDANCY = 16;
+const int SNAPSHOT_INTERVAL = 2;
+// Seconds; the server turns them into ticks at its own tick rate.
+const int NET_TIMEOUT_SECONDS = 5;
+const int RACE_END_SECONDS = 3;
+const int MAX_NET_PLATFORMS = 64;
+const std::uint32_t NO_BASELINE = 0xFFFFFFFF;
+const std::uint8_t NO_RACER = 0xFF;
+
+enum NetMessage : std::uint8_t {
+    MSG_JOIN = 1,
+    MSG_WELCOME,
+    MSG_INPUT,
+    MSG_ACK,
+    MSG_SNAPSHOT,
+    MSG_LEAVE
+};
+
+enum NetRole : std::uint8_t { ROLE_RACER, ROLE_SPECTATOR };
+
+enum RacerFlags : std::uint8_t {
+    RACER_CONNECTED = 1 << 0
+};
+
+// Everything about one racer's Simulation that the seed does not determine.
+// Platforms are rebuilt from the seed and the recycle count.
+struct RacerState {
+    static const int WORDS = 15;
+    std::uint32_t words[WORDS] = {};
+
+    bool operator==(const RacerState& o) const { return std::memcmp(words, o.words, sizeof(words)) == 0; }
+    bool operator!=(const RacerState& o) const { return !(*this == o); }
+
+    float f(int i) const {
+        float v;
+        std::memcpy(&v, &words[i], 4);
+        return v;
+    }
+    std::uint32_t ticks() const { return words[11]; }
+    std::int32_t score() const { return static_cast<std::int32_t>(words[10]); }
+    bool gameOver() const { return (words[6] >> 4) & 1; }
+    Vec2 pos() const { return {f(0), f(1)}; }
+    bool facingRight() const { return (words[6] >> 3) & 1; }
+};
+
+inline std::uint32_t floatBits(float v) {
+    std::uint32_t bits;
+    std::memcpy(&bits, &v, 4);
+    return bits;
+}
+
+// The scored flags go bottom to top from the ring head.
+inline RacerState captureRacer(const Simulation& sim) {
+    const PlayerState& p = sim.player;
+    std::uint64_t scored = 0;
+    for (int k = 0; k < sim.platformCount() && k < MAX_NET_PLATFORMS; k++) {
+        if (sim.platformAt(k).scored) scored |= std::uint64_t(1) << k;
+    }
+    RacerState s;
+    s.words[0] = floatBits(p.pos.x);
+    s.words[1] = floatBits(p.pos.y);
+    s.words[2] = floatBits(p.vel.x);
+    s.words[3] = floatBits(p.vel.y);
+    s.words[4] = floatBits(p.lastWall.x);
+    s.words[5] = floatBits(p.lastWall.y);
+    s.words[6] = p.canJump | p.canDoubleJump << 1 | p.isWallJumping << 2 | p.facingRight << 3 |
+                 sim.gameOver << 4 | std::uint32_t(sim.lastInput) << 8;
+    s.words[7] = floatBits(sim.cameraY);
+    s.words[8] = floatBits(sim.scrollSpeed);
+    s.words[9] = floatBits(sim.highestY);
+    s.words[10] = static_cast<std::uint32_t>(sim.score);
+    s.words[11] = static_cast<std::uint32_t>(sim.ticks);
+    s.words[12] = sim.recycled;
+    s.words[13] = static_cast<std::uint32_t>(scored);
+    s.words[14] = static_cast<std::uint32_t>(scored >> 32);
+    return s;
+}
+
+// Puts sim into state s of the tower grown from seed. The platform ring is
+// advanced by recycling, or regrown from the seed if it is already past s.
+inline void restoreRacer(Simulation& sim, std::uint64_t seed, const RacerState& s) {
+    if (sim.recycled > s.words[12]) sim.reset(seed);
+    while (sim.recycled < s.words[12]) sim.recyclePlatform();
+    PlayerState& p = sim.player;
+    p.pos = {s.f(0), s.f(1)};
+    p.vel = {s.f(2), s.f(3)};
+    p.lastWall = {s.f(4), s.f(5)};
+    p.canJump = s.words[6] & 1;
+    p.canDoubleJump = (s.words[6] >> 1) & 1;
+    p.isWallJumping = (s.words[6] >> 2) & 1;
+    p.facingRight = (s.words[6] >> 3) & 1;
+    sim.gameOver = s.gameOver();
+    sim.lastInput = static_cast<std::uint8_t>(s.words[6] >> 8);
+    sim.cameraY = s.f(7);
+    sim.scrollSpeed = s.f(8);
+    sim.highestY = s.f(9);
+    sim.score = s.score();
+    sim.ticks = s.ticks();
+    std::uint64_t scored = s.words[13] | std::uint64_t(s.words[14]) << 32;
+    for (int k = 0; k < sim.platformCount() && k < MAX_NET_PLATFORMS; k++) {
+        sim.platforms[(sim.platformHead + k) % sim.platformCount()].scored = (scored >> k) & 1;
+    }
+    sim.burstCount = 0;
+}
+
+// A mask of the words that differ from the baseline, then each of those as
+// a varint of the XOR. Neighbouring floats share their high bits, so most
+// changed words take two or three bytes.
+inline void writeRacerDelta(ByteWriter& w, const RacerState& s, const RacerState& base) {
+    std::uint32_t mask = 0;
+    for (int i = 0; i < RacerState::WORDS; i++) {
+        if (s.words[i] != base.words[i]) mask |= 1u << i;
+    }
+    w.varint(mask);
+    for (int i = 0; i < RacerState::WORDS; i++) {
+        if (mask & (1u << i)) w.varint(s.words[i] ^ base.words[i]);
+    }
+}
+
+inline RacerState readRacerDelta(ByteReader& r, const RacerState& base) {
+    RacerState s = base;
+    std::uint64_t mask = r.varint();
+    for (int i = 0; i < RacerState::WORDS; i++) {
+        if (mask & (1u << i)) s.words[i] ^= static_cast<std::uint32_t>(r.varint());
+    }
+    return s;
+}
+
+// Opaque to the protocol: whatever identifies a peer to the transport.
+using NetAddress = std::uint64_t;
+
+// Authoritative side. Players are grouped into races of racersPerRace as
+// they join; any number of spectators watch the newest race. Every tick
+// each race's clock advances and each racer is stepped through the inputs
+// that have arrived, waiting up to MAX_INPUT_LAG ticks for late ones.
+// Races use the classic rules, since RacerState carries no platform or
+// pickup state.
+class RaceServer {
+public:
+    struct Stats {
+        int races = 0;
+        int racers = 0;
+        int spectators = 0;
+        std::uint64_t packetsIn = 0, packetsOut = 0;
+        std::uint64_t bytesIn = 0, bytesOut = 0;
+        std::uint64_t guessedInputs = 0;
+    };
+
+    Stats stats;
+
+    RaceServer(const SimParams& params, int tickRate, int racersPerRace)
+        : params(params.classic()), tickRate(tickRate), timeoutTicks(NET_TIMEOUT_SECONDS * tickRate),
+          raceEndTicks(RACE_END_SECONDS * tickRate), racersPerRace(racersPerRace), now(timeoutTicks),
+          rng(std::random_device()()) {
+        if (params.platformCount > MAX_NET_PLATFORMS) this->params.platformCount = MAX_NET_PLATFORMS;
+    }
+
+    void receive(NetAddress from, const std::uint8_t* data, std::size_t size) {
+        stats.packetsIn++;
+        stats.bytesIn += size;
+        ByteReader r(data, size);
+        std::uint8_t type = r.u8();
+        int c = findClient(from);
+        if (type == MSG_JOIN) {
+            std::uint8_t protocol = r.u8();
+            std::uint8_t role = r.u8();
+            if (!r.ok || protocol != NET_PROTOCOL || role > ROLE_SPECTATOR) return;
+            if (c < 0) {
+                c = static_cast<int>(clients.size());
+                clients.push_back(Client());
+                clients[c].addr = from;
+                clients[c].role = static_cast<NetRole>(role);
+            }
+            clients[c].lastHeard = now;
+            clients[c].welcomed = false;
+            return;
+        }
+        if (c < 0) return;
+        Client& client = clients[c];
+        client.lastHeard = now;
+        if (type == MSG_LEAVE) {
+            client.lastHeard = now - timeoutTicks;
+            return;
+        }
+        std::uint32_t raceId = r.u32();
+        std::uint32_t ack = r.u32();
+        if (!r.ok) return;
+        Race* race = findRace(client.race);
+        if (!race || race->id != raceId) return;
+        if (ack != NO_BASELINE && ack <= race->tick && (!client.hasAck || ack > client.ackTick)) {
+            client.ackTick = ack;
+            client.hasAck = true;
+        }
+        if (type != MSG_INPUT || client.racer < 0) return;
+        std::uint32_t first = r.u32();
+        int count = r.u8();
+        Racer& racer = race->racers[client.racer];
+        for (int i = 0; i < count; i++) {
+            std::uint8_t input = r.u8();
+            std::uint32_t tick = first + i;
+            if (!r.ok) return;
+            // Only ticks not stepped yet and inside the window.
+            if (tick < racer.sim.ticks || tick >= racer.sim.ticks + NET_HISTORY) continue;
+            racer.inputs[tick % NET_HISTORY] = input;
+            racer.inputTicks[tick % NET_HISTORY] = tick;
+        }
+    }
+
+    // One server tick; send(addr, data, size) delivers a datagram.
+    template <typename Send>
+    void tick(Send&& send) {
+        now++;
+        dropSilentClients();
+        formRaces();
+        welcome(send);
+        for (Race& race : races) stepRace(race);
+        for (Race& race : races) {
+            if (now % SNAPSHOT_INTERVAL == 0) sendSnapshots(race, send);
+        }
+        retireRaces();
+
+        stats.races = static_cast<int>(races.size());
+        stats.racers = stats.spectators = 0;
+        for (const Client& client : clients) {
+            if (client.role == ROLE_RACER) stats.racers++;
+            else stats.spectators++;
+        }
+    }
+
+private:
+    struct Client {
+        NetAddress addr = 0;
+        NetRole role = ROLE_RACER;
+        std::uint32_t race = 0;
+        int racer = -1;
+        std::uint64_t lastHeard = 0;
+        std::uint32_t ackTick = 0;
+        bool hasAck = false;
+        bool welcomed = false;
+    };
+
+    struct Racer {
+        Simulation sim;
+        std::uint8_t inputs[NET_HISTORY] = {};
+        std::uint32_t inputTicks[NET_HISTORY];
+        std::uint8_t lastInput = 0;
+        bool connected = true;
+
+        Racer() { std::fill(std::begin(inputTicks), std::end(inputTicks), NO_BASELINE); }
+    };
+
+    struct Race {
+        std::uint32_t id = 0;
+        std::uint64_t seed = 0;
+        std::uint32_t tick = 0;
+        std::vector<Racer> racers;
+        // Racer states as sent at each of the last NET_HISTORY ticks.
+        std::vector<RacerState> history;
+        bool over = false;
+        int endTicks = 0;
+        // Encoded racer list of this tick, per baseline, shared by clients.
+        std::vector<std::uint32_t> cachedBaselines;
+        std::vector<std::vector<std::uint8_t>> cachedBodies;
+    };
+
+    SimParams params;
+    int tickRate;
+    int timeoutTicks;
+    int raceEndTicks;
+    int racersPerRace;
+    std::vector<Client> clients;
+    std::vector<Race> races;
+    std::uint32_t nextRaceId = 1;
+    std::uint64_t now;
+    Rng rng;
+    ByteWriter packet;
+
+    int findClient(NetAddress addr) const {
+        for (std::size_t i = 0; i < clients.size(); i++) {
+            if (clients[i].addr == addr) return static_cast<int>(i);
+        }
+        return -1;
+    }
+
+    Race* findRace(std::uint32_t id) {
+        for (Race& race : races) {
+            if (race.id == id) return &race;
+        }
+        return nullptr;
+    }
+
+    void dropSilentClients() {
+        for (std::size_t i = 0; i < clients.size();) {
+            if (now - clients[i].lastHeard < static_cast<std::uint64_t>(timeoutTicks)) {
+                i++;
+                continue;
+            }
+            if (Race* race = findRace(clients[i].race)) {
+                if (clients[i].racer >= 0) race->racers[clients[i].racer].connected = false;
+            }
+            clients.erase(clients.begin() + i);
+        }
+    }
+
+    // Waiting racers start a race once there are enough of them; waiting
+    // spectators join the newest race.
+    void formRaces() {
+        std::vector<int> waiting;
+        for (std::size_t i = 0; i < clients.size(); i++) {
+            if (clients[i].role == ROLE_RACER && clients[i].race == 0) waiting.push_back(static_cast<int>(i));
+        }
+        for (std::size_t start = 0; start + racersPerRace <= waiting.size(); start += racersPerRace) {
+            races.push_back(Race());
+            Race& race = races.back();
+            race.id = nextRaceId++;
+            race.seed = rng.next();
+            race.racers.resize(racersPerRace);
+            race.history.resize(static_cast<std::size_t>(NET_HISTORY) * racersPerRace);
+            for (int k = 0; k < racersPerRace; k++) {
+                Client& client = clients[waiting[start + k]];
+                client.race = race.id;
+                client.racer = k;
+                client.hasAck = false;
+                race.racers[k].sim = Simulation(params);
+                race.racers[k].sim.reset(race.seed);
+            }
+        }
+        if (races.empty()) return;
+        for (Client& client : clients) {
+            if (client.role == ROLE_SPECTATOR && !findRace(client.race)) {
+                client.race = races.back().id;
+                client.hasAck = false;
+            }
+        }
+    }
+
+    template <typename Send>
+    void welcome(Send& send) {
+        for (Client& client : clients) {
+            if (client.welcomed) continue;
+            client.welcomed = true;
+            packet.bytes.clear();
+            packet.u8(MSG_WELCOME);
+            packet.u8(NET_PROTOCOL);
+            packet.u16(static_cast<std::uint16_t>(tickRate));
+            writeParams(packet, params);
+            packet.u8(static_cast<std::uint8_t>(racersPerRace));
+            deliver(send, client.addr);
+        }
+    }
+
+    void stepRace(Race& race) {
+        if (race.over) {
+            race.endTicks++;
+            return;
+        }
+        race.tick++;
+        const float deltaTime = 1.0f / tickRate;
+        bool anyAlive = false;
+        for (int k = 0; k < static_cast<int>(race.racers.size()); k++) {
+            Racer& racer = race.racers[k];
+            while (!racer.sim.gameOver && racer.sim.ticks < race.tick) {
+                std::uint32_t t = static_cast<std::uint32_t>(racer.sim.ticks);
+                std::uint8_t input;
+                if (racer.inputTicks[t % NET_HISTORY] == t) {
+                    input = racer.inputs[t % NET_HISTORY];
+                } else if (race.tick - t > MAX_INPUT_LAG || !racer.connected) {
+                    input = racer.lastInput & ~INPUT_JUMP_PRESSED;
+                    stats.guessedInputs++;
+                } else {
+                    break;
+                }
+                racer.lastInput = input;
+                racer.sim.step(input, deltaTime);
+            }
+            race.history[historySlot(race, race.tick, k)] = captureRacer(racer.sim);
+            if (!racer.sim.gameOver && racer.connected) anyAlive = true;
+        }
+        race.over = !anyAlive;
+    }
+
+    std::size_t historySlot(const Race& race, std::uint32_t tick, int racer) const {
+        return static_cast<std::size_t>(tick % NET_HISTORY) * race.racers.size() + racer;
+    }
+
+    template <typename Send>
+    void sendSnapshots(Race& race, Send& send) {
+        race.cachedBaselines.clear();
+        for (Client& client : clients) {
+            if (client.race != race.id || !client.welcomed) continue;
+            std::uint32_t baseline = NO_BASELINE;
+            if (client.hasAck && race.tick - client.ackTick < NET_HISTORY) baseline = client.ackTick;
+            const std::vector<std::uint8_t>& body = encodeRacers(race, baseline);
+            packet.bytes.clear();
+            packet.u8(MSG_SNAPSHOT);
+            packet.u32(race.id);
+            packet.u64(race.seed);
+            packet.u32(race.tick);
+            packet.u32(baseline);
+            packet.u8(client.racer < 0 ? NO_RACER : static_cast<std::uint8_t>(client.racer));
+            packet.bytes.insert(packet.bytes.end(), body.begin(), body.end());
+            deliver(send, client.addr);
+        }
+    }
+
+    const std::vector<std::uint8_t>& encodeRacers(Race& race, std::uint32_t baseline) {
+        for (std::size_t i = 0; i < race.cachedBaselines.size(); i++) {
+            if (race.cachedBaselines[i] == baseline) return race.cachedBodies[i];
+        }
+        std::size_t i = race.cachedBaselines.size();
+        race.cachedBaselines.push_back(baseline);
+        if (race.cachedBodies.size() <= i) race.cachedBodies.resize(i + 1);
+        ByteWriter w;
+        w.bytes.swap(race.cachedBodies[i]);
+        w.bytes.clear();
+        w.u8(static_cast<std::uint8_t>(race.racers.size()));
+        static const RacerState zero;
+        for (int k = 0; k < static_cast<int>(race.racers.size()); k++) {
+            w.u8(race.racers[k].connected ? RACER_CONNECTED : 0);
+            const RacerState& base = baseline == NO_BASELINE ? zero : race.history[historySlot(race, baseline, k)];
+            writeRacerDelta(w, race.history[historySlot(race, race.tick, k)], base);
+        }
+        w.bytes.swap(race.cachedBodies[i]);
+        return race.cachedBodies[i];
+    }
+
+    template <typename Send>
+    void deliver(Send& send, NetAddress addr) {
+        stats.packetsOut++;
+        stats.bytesOut += packet.bytes.size();
+        send(addr, packet.bytes.data(), packet.bytes.size());
+    }
+
+    // Finished races linger so everyone sees the result, then their racers
+    // queue up for the next one.
+    void retireRaces() {
+        for (std::size_t i = 0; i < races.size();) {
+            if (!races[i].over || races[i].endTicks < raceEndTicks) {
+                i++;
+                continue;
+            }
+            for (Client& client : clients) {
+                if (client.race != races[i].id) continue;
+                client.race = 0;
+                client.racer = -1;
+                client.hasAck = false;
+            }
+            races.erase(races.begin() + i);
+        }
+    }
+};
+
+// Client side. A racer predicts their own Simulation locally from their
+// inputs and sends them with redundancy; when a snapshot shows the server
+// stepped a different state, the local Simulation is put into the server's
+// state and the inputs since then are replayed. Spectators only follow.
+class RaceClient {
+public:
+    NetRole role;
+    bool welcomed = false;
+    SimParams params;
+    int tickRate = TICK_RATE;
+    int racersPerRace = 0;
+    std::uint32_t raceId = 0;
+    std::uint64_t seed = 0;
+    int localRacer = -1;
+    std::uint32_t serverTick = 0;
+    int racerCount = 0;
+    RacerState racers[MAX_RACERS];
+    bool racerConnected[MAX_RACERS] = {};
+    std::uint64_t corrections = 0;
+
+    explicit RaceClient(NetRole role) : role(role) {
+        std::fill(std::begin(inputTicks), std::end(inputTicks), NO_BASELINE);
+        std::fill(std::begin(receivedTicks), std::end(receivedTicks), NO_BASELINE);
+        std::fill(std::begin(predictedTicks), std::end(predictedTicks), NO_BASELINE);
+    }
+
+    void writeJoin(ByteWriter& w) const {
+        w.u8(MSG_JOIN);
+        w.u8(NET_PROTOCOL);
+        w.u8(role);
+    }
+
+    void writeLeave(ByteWriter& w) const { w.u8(MSG_LEAVE); }
+
+    // Handles one datagram. Returns true when a new race started, after
+    // which the caller resets local to seed.
+    bool receive(const std::uint8_t* data, std::size_t size, Simulation& local) {
+        ByteReader r(data, size);
+        std::uint8_t type = r.u8();
+        if (type == MSG_WELCOME) {
+            if (r.u8() != NET_PROTOCOL) return false;
+            int rate = r.u16();
+            SimParams p = readParams(r);
+            int perRace = r.u8();
+            if (!r.ok) return false;
+            welcomed = true;
+            tickRate = rate;
+            params = p;
+            racersPerRace = perRace;
+            return false;
+        }
+        if (type != MSG_SNAPSHOT || !welcomed) return false;
+        std::uint32_t race = r.u32();
+        std::uint64_t raceSeed = r.u64();
+        std::uint32_t tick = r.u32();
+        std::uint32_t baseline = r.u32();
+        std::uint8_t you = r.u8();
+        int count = r.u8();
+        if (!r.ok || count > MAX_RACERS) return false;
+
+        // Race ids only go up, so a lower one is a late datagram from a
+        // race already left behind.
+        if (race < raceId) return false;
+        bool newRace = race > raceId;
+        if (newRace) {
+            raceId = race;
+            seed = raceSeed;
+            serverTick = 0;
+            std::fill(std::begin(inputTicks), std::end(inputTicks), NO_BASELINE);
+            std::fill(std::begin(receivedTicks), std::end(receivedTicks), NO_BASELINE);
+            std::fill(std::begin(predictedTicks), std::end(predictedTicks), NO_BASELINE);
+            local = Simulation(params);
+            local.reset(seed);
+        } else if (tick <= serverTick) {
+            return false;
+        }
+        const RacerState* base = nullptr;
+        if (baseline != NO_BASELINE) {
+            if (receivedTicks[baseline % NET_HISTORY] != baseline) return newRace;
+            base = received[baseline % NET_HISTORY];
+        }
+        static const RacerState zero;
+        RacerState states[MAX_RACERS];
+        bool connected[MAX_RACERS];
+        for (int k = 0; k < count; k++) {
+            connected[k] = r.u8() & RACER_CONNECTED;
+            states[k] = readRacerDelta(r, base ? base[k] : zero);
+        }
+        if (!r.ok) return newRace;
+
+        serverTick = tick;
+        racerCount = count;
+        localRacer = you == NO_RACER || you >= count ? -1 : you;
+        for (int k = 0; k < count; k++) {
+            racers[k] = states[k];
+            racerConnected[k] = connected[k];
+            received[tick % NET_HISTORY][k] = states[k];
+        }
+        receivedTicks[tick % NET_HISTORY] = tick;
+        if (localRacer >= 0) reconcile(local, racers[localRacer]);
+        return newRace;
+    }
+
+    // Racers: predict one tick locally and queue the input for the server.
+    void step(Simulation& local, std::uint8_t input, float deltaTime) {
+        if (localRacer < 0 || local.gameOver) return;
+        std::uint32_t t = static_cast<std::uint32_t>(local.ticks);
+        inputs[t % NET_HISTORY] = input;
+        inputTicks[t % NET_HISTORY] = t;
+        local.step(input, deltaTime);
+        predicted[t % NET_HISTORY] = captureRacer(local);
+        predictedTicks[t % NET_HISTORY] = t;
+    }
+
+    // Sent every tick: the newest inputs the server may still be missing
+    // (racers) or just the acknowledgement (spectators and waiting racers).
+    void writeUpdate(ByteWriter& w, const Simulation& local) const {
+        std::uint32_t ack = receivedTicks[serverTick % NET_HISTORY] == serverTick ? serverTick : NO_BASELINE;
+        if (localRacer < 0) {
+            w.u8(MSG_ACK);
+            w.u32(raceId);
+            w.u32(ack);
+            return;
+        }
+        std::uint32_t end = static_cast<std::uint32_t>(local.ticks);
+        std::uint32_t confirmed = racers[localRacer].ticks();
+        std::uint32_t first = end > INPUT_REDUNDANCY ? end - INPUT_REDUNDANCY : 0;
+        first = std::max(first, std::min(confirmed, end));
+        w.u8(MSG_INPUT);
+        w.u32(raceId);
+        w.u32(ack);
+        w.u32(first);
+        w.u8(static_cast<std::uint8_t>(end - first));
+        for (std::uint32_t t = first; t < end; t++) w.u8(inputs[t % NET_HISTORY]);
+    }
+
+    // Ticks the local clock should run this tick instead of one. Inputs for
+    // tick t have to reach the server before it gives up on them, so racers
+    // run a little ahead: a server short of inputs speeds the client up, one
+    // never waiting for them slows it down.
+    int pace() const {
+        if (localRacer < 0 || racers[localRacer].gameOver()) return 1;
+        std::uint32_t lag = serverTick - racers[localRacer].ticks();
+        if (lag > 4) return 2;
+        if (lag == 0) return 0;
+        return 1;
+    }
+
+    // Index of the racer furthest up the tower, for spectators to follow.
+    int leader() const {
+        int best = -1;
+        for (int k = 0; k < racerCount; k++) {
+            if (best < 0 || racers[k].pos().y < racers[best].pos().y) best = k;
+        }
+        return best;
+    }
+
+private:
+    std::uint8_t inputs[NET_HISTORY];
+    std::uint32_t inputTicks[NET_HISTORY];
+    RacerState predicted[NET_HISTORY];
+    std::uint32_t predictedTicks[NET_HISTORY];
+    RacerState received[NET_HISTORY][MAX_RACERS];
+    std::uint32_t receivedTicks[NET_HISTORY];
+
+    // server is the racer after server.ticks() steps. If the prediction for
+    // that tick differs, rewind to it and replay the inputs since.
+    void reconcile(Simulation& local, const RacerState& server) {
+        std::uint32_t t = server.ticks();
+        if (t == 0) return;
+        std::uint32_t slot = (t - 1) % NET_HISTORY;
+        if (predictedTicks[slot] == t - 1 && predicted[slot] == server) return;
+        corrections++;
+        std::uint32_t end = static_cast<std::uint32_t>(local.ticks);
+        restoreRacer(local, seed, server);
+        const float deltaTime = 1.0f / tickRate;
+        for (std::uint32_t i = t; i < end && !local.gameOver; i++) {
+            if (inputTicks[i % NET_HISTORY] != i) break;
+            local.step(inputs[i % NET_HISTORY], deltaTime);
+            predicted[i % NET_HISTORY] = captureRacer(local);
+            predictedTicks[i % NET_HISTORY] = i;
+        }
+    }
+};
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <SFML/Network.hpp>
+#include "net.h"
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+
+inline NetAddress toNetAddress(const sf::IpAddress& ip, unsigned short port) {
+    return static_cast<std::uint64_t>(ip.toInteger()) << 16 | port;
+}
+
+inline sf::IpAddress netIp(NetAddress address) {
+    return sf::IpAddress(static_cast<sf::Uint32>(address >> 16));
+}
+
+inline unsigned short netPort(NetAddress address) {
+    return static_cast<unsigned short>(address & 0xFFFF);
+}
+
+// "host" or "host:port"; false if the host does not resolve.
+inline bool parseEndpoint(const std::string& text, NetAddress& out) {
+    std::string host = text;
+    unsigned short port = NET_PORT;
+    std::size_t colon = text.rfind(':');
+    if (colon != std::string::npos) {
+        host = text.substr(0, colon);
+        port = static_cast<unsigned short>(std::atoi(text.c_str() + colon + 1));
+    }
+    sf::IpAddress ip(host);
+    if (ip == sf::IpAddress::None || port == 0) return false;
+    out = toNetAddress(ip, port);
+    return true;
+}
+
+// Non-blocking UDP socket speaking in NetAddresses.
+class NetSocket {
+public:
+    bool bind(unsigned short port = sf::Socket::AnyPort) {
+        socket.setBlocking(false);
+        return socket.bind(port) == sf::Socket::Done;
+    }
+
+    void send(NetAddress to, const std::uint8_t* data, std::size_t size) {
+        socket.send(data, size, netIp(to), netPort(to));
+    }
+
+    // handle(from, data, size) for every datagram already waiting.
+    template <typename Handle>
+    void receiveAll(Handle&& handle) {
+        sf::IpAddress ip;
+        unsigned short port;
+        std::size_t size;
+        while (socket.receive(buffer, sizeof(buffer), size, ip, port) == sf::Socket::Done) {
+            handle(toNetAddress(ip, port), buffer, size);
+        }
+    }
+
+private:
+    sf::UdpSocket socket;
+    std::uint8_t buffer[1500];
+};
+
+// A RaceClient talking to one server: joins until welcomed, then sends its
+// inputs or acknowledgements once per tick.
+class RaceConnection {
+public:
+    RaceClient client;
+    NetAddress server;
+
+    RaceConnection(NetRole role, NetAddress server) : client(role), server(server) {
+        packet.bytes.reserve(256);
+    }
+
+    bool open() { return socket.bind(); }
+
+    // Returns true when a new race started and local was reset to its seed.
+    bool poll(Simulation& local) {
+        bool newRace = false;
+        socket.receiveAll([&](NetAddress from, const std::uint8_t* data, std::size_t size) {
+            if (from == server && client.receive(data, size, local)) newRace = true;
+        });
+        return newRace;
+    }
+
+    void send(const Simulation& local) {
+        packet.bytes.clear();
+        if (client.welcomed) client.writeUpdate(packet, local);
+        else client.writeJoin(packet);
+        socket.send(server, packet.bytes.data(), packet.bytes.size());
+    }
+
+    void leave() {
+        packet.bytes.clear();
+        client.writeLeave(packet);
+        socket.send(server, packet.bytes.data(), packet.bytes.size());
+    }
+
+private:
+    NetSocket socket;
+    ByteWriter packet;
+};
@@ -0,0 +1,91 @@
+#include <SFML/Graphics.hpp>
+#include "asset_bundle.h"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// Build step: decodes every .png argument to RGBA8 and packs it, together with
+// any other files (the font), into one bundle the game can map at startup.
+// Usage: pack_assets <output> <file>...
+
+static std::string baseName(const std::string& path) {
+    size_t slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+static bool endsWith(const std::string& s, const std::string& suffix) {
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "Usage: pack_assets <output> <file>..." << std::endl;
+        return 1;
+    }
+
+    std::vector<BundleEntry> entries;
+    std::vector<std::vector<std::uint8_t>> payloads;
+    for (int i = 2; i < argc; i++) {
+        std::string path = argv[i];
+        std::string name = baseName(path);
+        BundleEntry entry = {};
+        if (name.size() >= sizeof(entry.name)) {
+            std::cerr << "Asset name too long: " << name << "." << std::endl;
+            return 1;
+        }
+        std::strcpy(entry.name, name.c_str());
+
+        std::vector<std::uint8_t> bytes;
+        if (endsWith(name, ".png")) {
+            sf::Image image;
+            if (!image.loadFromFile(path)) {
+                std::cerr << "Failed to load " << path << "." << std::endl;
+                return 1;
+            }
+            entry.kind = BundleKind::ImageRGBA;
+            entry.width = image.getSize().x;
+            entry.height = image.getSize().y;
+            const std::uint8_t* pixels = image.getPixelsPtr();
+            bytes.assign(pixels, pixels + std::size_t(entry.width) * entry.height * 4);
+        } else {
+            std::ifstream file(path, std::ios::binary);
+            if (!file) {
+                std::cerr << "Failed to load " << path << "." << std::endl;
+                return 1;
+            }
+            entry.kind = BundleKind::Raw;
+            bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        }
+        entry.size = bytes.size();
+        entries.push_back(entry);
+        payloads.push_back(std::move(bytes));
+    }
+
+    std::uint64_t offset = sizeof(BundleHeader) + entries.size() * sizeof(BundleEntry);
+    for (auto& entry : entries) {
+        offset = (offset + 15) & ~std::uint64_t(15);
+        entry.offset = offset;
+        offset += entry.size;
+    }
+
+    std::ofstream out(argv[1], std::ios::binary);
+    BundleHeader header = {};
+    std::memcpy(header.magic, BUNDLE_MAGIC, 4);
+    header.version = BUNDLE_VERSION;
+    header.entryCount = static_cast<std::uint32_t>(entries.size());
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(BundleEntry));
+    for (size_t i = 0; i < entries.size(); i++) {
+        while (static_cast<std::uint64_t>(out.tellp()) < entries[i].offset) out.put('\0');
+        out.write(reinterpret_cast<const char*>(payloads[i].data()), payloads[i].size());
+    }
+    if (!out) {
+        std::cerr << "Failed to write " << argv[1] << "." << std::endl;
+        return 1;
+    }
+    std::cout << "Packed " << entries.size() << " assets into " << argv[1] << " (" << offset << " bytes)" << std::endl;
+    return 0;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "sim.h"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+const int MAX_PARTICLES = 4096;
+const int PARTICLES_PER_BURST = 5;
+const float PARTICLE_LIFETIME = 0.5f;
+
+// Fixed-capacity particle storage laid out as parallel arrays. All memory is
+// reserved up front; dead particles are swap-removed, so order is not stable.
+class ParticlePool {
+public:
+    int count;
+    std::vector<float> x, y, vx, vy, lifetime, size;
+    std::vector<std::uint8_t> r, g, b;
+
+    explicit ParticlePool(int capacity = MAX_PARTICLES, std::uint64_t seed = 1)
+        : count(0), x(capacity), y(capacity), vx(capacity), vy(capacity),
+          lifetime(capacity), size(capacity), r(capacity), g(capacity), b(capacity), rng(seed) {}
+
+    int capacity() const { return static_cast<int>(x.size()); }
+
+    // Drops particles once the pool is full rather than growing it.
+    void emit(float px, float py, float radius, int n = PARTICLES_PER_BURST) {
+        for (int i = 0; i < n && count < capacity(); i++, count++) {
+            x[count] = px;
+            y[count] = py;
+            vx[count] = (rng.nextInt(200) - 100) / 100.0f;
+            vy[count] = (rng.nextInt(200) - 100) / 100.0f;
+            lifetime[count] = PARTICLE_LIFETIME;
+            size[count] = radius;
+            r[count] = static_cast<std::uint8_t>(rng.nextInt(255));
+            g[count] = static_cast<std::uint8_t>(rng.nextInt(255));
+            b[count] = static_cast<std::uint8_t>(rng.nextInt(255));
+        }
+    }
+
+    void update(float deltaTime) {
+        float step = deltaTime * 60.0f;
+        for (int i = 0; i < count; i++) {
+            x[i] += vx[i] * step;
+            y[i] += vy[i] * step;
+            lifetime[i] -= deltaTime;
+        }
+        for (int i = 0; i < count;) {
+            if (lifetime[i] <= 0) removeAt(i);
+            else i++;
+        }
+    }
+
+    std::uint8_t alpha(int i) const {
+        return static_cast<std::uint8_t>(200 * lifetime[i] / PARTICLE_LIFETIME);
+    }
+
+    void clear() { count = 0; }
+
+    // Copies the live particles into this pool's storage without allocating.
+    void copyFrom(const ParticlePool& other) {
+        count = std::min(other.count, capacity());
+        std::copy_n(other.x.begin(), count, x.begin());
+        std::copy_n(other.y.begin(), count, y.begin());
+        std::copy_n(other.vx.begin(), count, vx.begin());
+        std::copy_n(other.vy.begin(), count, vy.begin());
+        std::copy_n(other.lifetime.begin(), count, lifetime.begin());
+        std::copy_n(other.size.begin(), count, size.begin());
+        std::copy_n(other.r.begin(), count, r.begin());
+        std::copy_n(other.g.begin(), count, g.begin());
+        std::copy_n(other.b.begin(), count, b.begin());
+    }
+
+private:
+    Rng rng;
+
+    void removeAt(int i) {
+        int last = --count;
+        x[i] = x[last];
+        y[i] = y[last];
+        vx[i] = vx[last];
+        vy[i] = vy[last];
+        lifetime[i] = lifetime[last];
+        size[i] = size[last];
+        r[i] = r[last];
+        g[i] = g[last];
+        b[i] = b[last];
+    }
+};
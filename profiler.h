@@ -0,0 +1,215 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+// Scoped per-phase timings collected into a lock-free ring buffer. Recording
+// is off until Profiler::instance().setEnabled(true); while off a scope costs
+// one relaxed atomic load. Build with -DICY_NO_PROFILE to compile it out.
+enum class Phase : std::uint8_t {
+    Frame,
+    Events,
+    Input,
+    WallJump,
+    PlayerUpdate,
+    Collisions,
+    Camera,
+    Background,
+    Particles,
+    Text,
+    Draw,
+    Display,
+    Tower,
+    Snapshot,
+    Platforms,
+    Capture,
+    Bot,
+    Count
+};
+
+inline const char* phaseName(Phase phase) {
+    static const char* const names[] = {
+        "frame", "events", "handleInput", "checkWallJump", "Player::update", "handleCollisions",
+        "updateCamera", "updateBackground", "particles", "updateText", "draw", "display",
+        "generateChunk", "publishSnapshot", "updatePlatforms", "capture", "LookaheadBot::plan"
+    };
+    return names[static_cast<int>(phase)];
+}
+
+const int PHASE_COUNT = static_cast<int>(Phase::Count);
+const int PROFILE_EVENT_CAPACITY = 1 << 16;
+const int PROFILE_FRAME_HISTORY = 240;
+
+struct PhaseStats {
+    float p50Ms = 0;
+    float p99Ms = 0;
+};
+
+class Profiler {
+public:
+    static Profiler& instance() {
+        static Profiler profiler;
+        return profiler;
+    }
+
+    static std::uint64_t nowNs() {
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    bool enabled() const { return on.load(std::memory_order_relaxed); }
+    void setEnabled(bool value) { on.store(value, std::memory_order_relaxed); }
+
+    // Scopes on a muted thread record nothing, so the bot's throwaway
+    // lookahead steps do not crowd the game's own out of the buffer.
+    static bool& muted() {
+        thread_local bool value = false;
+        return value;
+    }
+
+    // Safe from any thread. Slots are claimed with one fetch_add; a slot's
+    // sequence number is published last so readers can skip torn entries.
+    void record(Phase phase, std::uint64_t startNs, std::uint64_t endNs) {
+        std::uint64_t index = head.fetch_add(1, std::memory_order_relaxed);
+        Slot& slot = slots[index & (PROFILE_EVENT_CAPACITY - 1)];
+        slot.seq.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.start.store(startNs, std::memory_order_relaxed);
+        slot.duration.store(static_cast<std::uint32_t>(std::min<std::uint64_t>(endNs - startNs, UINT32_MAX)),
+                            std::memory_order_relaxed);
+        slot.meta.store(static_cast<std::uint32_t>(phase) | (threadIndex() << 8), std::memory_order_relaxed);
+        slot.seq.store(index + 1, std::memory_order_release);
+    }
+
+    // Main thread, once per presented frame.
+    void endFrame(float frameMs, int frameDrawCalls, int frameParticles) {
+        frameTimes[frameCursor] = frameMs;
+        frameCursor = (frameCursor + 1) % PROFILE_FRAME_HISTORY;
+        frameCount = std::min(frameCount + 1, PROFILE_FRAME_HISTORY);
+        drawCalls = frameDrawCalls;
+        particles = frameParticles;
+    }
+
+    // Oldest first.
+    float frameTime(int i) const {
+        int start = (frameCursor - frameCount + PROFILE_FRAME_HISTORY) % PROFILE_FRAME_HISTORY;
+        return frameTimes[(start + i) % PROFILE_FRAME_HISTORY];
+    }
+    int frameHistory() const { return frameCount; }
+    int lastDrawCalls() const { return drawCalls; }
+    int lastParticles() const { return particles; }
+
+    // p50/p99 of each phase over its most recent STATS_SAMPLES events, so
+    // busy phases reflect the current frames rather than the oldest ones
+    // still in the buffer.
+    void computeStats(PhaseStats out[PHASE_COUNT]) {
+        int counts[PHASE_COUNT] = {};
+        forEachEvent(false, [&](Phase phase, std::uint64_t, std::uint32_t durationNs, std::uint32_t) {
+            int p = static_cast<int>(phase);
+            if (counts[p] < STATS_SAMPLES) scratch[p][counts[p]++] = durationNs;
+        });
+        for (int p = 0; p < PHASE_COUNT; p++) {
+            out[p] = PhaseStats();
+            if (counts[p] == 0) continue;
+            std::uint32_t* begin = scratch[p];
+            std::uint32_t* end = begin + counts[p];
+            std::uint32_t* mid = begin + counts[p] / 2;
+            std::nth_element(begin, mid, end);
+            out[p].p50Ms = *mid / 1e6f;
+            std::uint32_t* high = begin + std::min(counts[p] - 1, counts[p] * 99 / 100);
+            std::nth_element(begin, high, end);
+            out[p].p99Ms = *high / 1e6f;
+        }
+    }
+
+    // chrome://tracing / Perfetto "complete" events, one per recorded scope.
+    bool writeChromeTrace(const std::string& path) {
+        std::ofstream file(path);
+        if (!file) return false;
+        file << "{\"traceEvents\":[\n";
+        bool first = true;
+        char line[160];
+        forEachEvent(true, [&](Phase phase, std::uint64_t startNs, std::uint32_t durationNs, std::uint32_t thread) {
+            std::snprintf(line, sizeof(line),
+                          "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+                          first ? "" : ",\n", phaseName(phase), startNs / 1e3, durationNs / 1e3, thread);
+            file << line;
+            first = false;
+        });
+        file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+        return static_cast<bool>(file);
+    }
+
+private:
+    static const int STATS_SAMPLES = 4096;
+
+    struct Slot {
+        std::atomic<std::uint64_t> seq{0};
+        std::atomic<std::uint64_t> start{0};
+        std::atomic<std::uint32_t> duration{0};
+        std::atomic<std::uint32_t> meta{0};
+    };
+
+    std::atomic<bool> on{false};
+    std::atomic<std::uint64_t> head{0};
+    Slot slots[PROFILE_EVENT_CAPACITY];
+    float frameTimes[PROFILE_FRAME_HISTORY] = {};
+    int frameCursor = 0;
+    int frameCount = 0;
+    int drawCalls = 0;
+    int particles = 0;
+    std::uint32_t scratch[PHASE_COUNT][STATS_SAMPLES];
+
+    Profiler() = default;
+
+    static std::uint32_t threadIndex() {
+        static std::atomic<std::uint32_t> nextThread{0};
+        thread_local std::uint32_t index = nextThread++;
+        return index;
+    }
+
+    // Oldest first, or newest first when oldestFirst is false.
+    template <typename F>
+    void forEachEvent(bool oldestFirst, F&& visit) {
+        std::uint64_t end = head.load(std::memory_order_acquire);
+        std::uint64_t begin = end > PROFILE_EVENT_CAPACITY ? end - PROFILE_EVENT_CAPACITY : 0;
+        for (std::uint64_t n = 0; n < end - begin; n++) {
+            std::uint64_t i = oldestFirst ? begin + n : end - 1 - n;
+            const Slot& slot = slots[i & (PROFILE_EVENT_CAPACITY - 1)];
+            if (slot.seq.load(std::memory_order_acquire) != i + 1) continue;
+            std::uint64_t start = slot.start.load(std::memory_order_relaxed);
+            std::uint32_t duration = slot.duration.load(std::memory_order_relaxed);
+            std::uint32_t meta = slot.meta.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.seq.load(std::memory_order_relaxed) != i + 1) continue;
+            visit(static_cast<Phase>(meta & 0xFF), start, duration, meta >> 8);
+        }
+    }
+};
+
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Phase phase)
+        : phase(phase), start(Profiler::instance().enabled() && !Profiler::muted() ? Profiler::nowNs() : 0) {}
+
+    ~ScopedTimer() {
+        if (start != 0) Profiler::instance().record(phase, start, Profiler::nowNs());
+    }
+
+private:
+    Phase phase;
+    std::uint64_t start;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#ifdef ICY_NO_PROFILE
+#define PROFILE_SCOPE(phase) ((void)0)
+#else
+#define PROFILE_SCOPE(phase) ScopedTimer PROFILE_CONCAT(profileScope, __LINE__)(phase)
+#endif
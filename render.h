@@ -0,0 +1,541 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include "sim.h"
+#include "particles.h"
+#include "asset_bundle.h"
+#include "profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <future>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Background themes by score: theme i starts at THEME_SCORES[i] and shows
+// background texture i.
+const int THEME_COUNT = 3;
+const int THEME_SCORES[THEME_COUNT] = {0, 100, 150};
+const float THEME_FADE_TIME = 0.25f;  // seconds
+
+inline int themeForScore(int score) {
+    int theme = 0;
+    while (theme + 1 < THEME_COUNT && score >= THEME_SCORES[theme + 1]) theme++;
+    return theme;
+}
+
+// Snow drifting over the theme background, far to near. parallax is the
+// share of the camera's climb a layer follows; drift is in pixels per second.
+struct ParallaxLayer {
+    float parallax;
+    float driftX, driftY;
+    unsigned tileSize;
+    int flakes;
+    float radius;
+    std::uint8_t alpha;
+};
+
+const ParallaxLayer PARALLAX_LAYERS[] = {
+    {0.1f, 3.0f, 10.0f, 256, 60, 1.2f, 110},
+    {0.25f, -5.0f, 22.0f, 256, 24, 2.0f, 160},
+    {0.5f, 8.0f, 40.0f, 384, 10, 3.2f, 210},
+};
+const int PARALLAX_LAYER_COUNT = sizeof(PARALLAX_LAYERS) / sizeof(PARALLAX_LAYERS[0]);
+
+// Loads textures from assets.bundle (pre-decoded pixels, memory-mapped) when
+// present, otherwise decodes the PNGs on worker threads. The menu's background
+// and the font are ready when the constructor returns; the menu uploads the
+// rest as they finish decoding, and finishLoading() waits for any left once
+// the game actually needs them. GPU uploads stay on the main thread, which
+// owns the GL context.
+class TextureManager {
+    // Declared first so it outlives the font, which streams glyphs straight
+    // from the mapped file.
+    AssetBundle bundle;
+
+public:
+    sf::Texture playerTexture;
+    sf::Texture platformTexture;
+    sf::Texture backgroundTextures[THEME_COUNT];
+    sf::Texture gameOverTexture;
+    sf::Font font;
+
+    TextureManager() {
+        bundle.open("assets.bundle");
+        load("background.png", backgroundTextures[0]);
+        load("pop.png", playerTexture);
+        load("step.png", platformTexture);
+        load("sunset.png", backgroundTextures[1]);
+        load("night.png", backgroundTextures[2]);
+        load("gameover.png", gameOverTexture);
+
+        const BundleEntry* fontEntry = bundle.find("DejaVuSans.ttf");
+        bool fontLoaded = fontEntry ? font.loadFromMemory(bundle.data(*fontEntry), fontEntry->size)
+                                    : font.loadFromFile("DejaVuSans.ttf");
+        if (!fontLoaded) {
+            std::cerr << "Failed to load DejaVuSans.ttf." << std::endl;
+            exit(1);
+        }
+        upload(pending.front());
+    }
+
+    // Uploads the textures that have finished decoding, without waiting.
+    void uploadReady() {
+        for (auto& p : pending) {
+            if (!p.done && p.image.wait_for(std::chrono::seconds(0)) == std::future_status::ready) upload(p);
+        }
+    }
+
+    void finishLoading() {
+        for (auto& p : pending) {
+            if (!p.done) upload(p);
+        }
+    }
+
+private:
+    struct Pending {
+        const char* file;
+        sf::Texture* texture;
+        std::future<sf::Image> image;
+        bool done;
+    };
+
+    std::vector<Pending> pending;
+
+    void load(const char* file, sf::Texture& texture) {
+        const BundleEntry* entry = bundle.find(file);
+        if (entry && entry->kind == BundleKind::ImageRGBA) {
+            if (!texture.create(entry->width, entry->height)) {
+                std::cerr << "Failed to create texture for " << file << "." << std::endl;
+                exit(1);
+            }
+            texture.update(bundle.data(*entry));
+            pending.push_back({file, &texture, std::future<sf::Image>(), true});
+            return;
+        }
+        pending.push_back({file, &texture, std::async(std::launch::async, [file]() {
+            sf::Image image;
+            image.loadFromFile(file);
+            return image;
+        }), false});
+    }
+
+    void upload(Pending& p) {
+        if (p.done) return;
+        p.done = true;
+        sf::Image image = p.image.get();
+        if (image.getSize().x == 0 || !p.texture->loadFromImage(image)) {
+            std::cerr << "Failed to load " << p.file << "." << std::endl;
+            exit(1);
+        }
+    }
+};
+
+// The theme background with the parallax layers over it. With shaders the
+// whole stack is one full-screen quad drawn in a single pass, however many
+// layers there are; without, every layer is a quad of its own. Textures
+// repeat, so scrolling only moves texture coordinates, and textures are only
+// rebound when the theme changes.
+class BackgroundRenderer {
+public:
+    // allowShader off forces the multi-pass fallback used without shaders.
+    explicit BackgroundRenderer(bool allowShader = true) : quad(sf::Quads, 4) {
+        for (int i = 0; i < PARALLAX_LAYER_COUNT; i++) {
+            if (!layers[i].loadFromImage(snowTile(PARALLAX_LAYERS[i], i + 1))) {
+                std::cerr << "Failed to create a parallax layer texture." << std::endl;
+                exit(1);
+            }
+            layers[i].setRepeated(true);
+            layers[i].setSmooth(true);
+        }
+        useShader = allowShader && sf::Shader::isAvailable() && shader.loadFromMemory(shaderSource(), sf::Shader::Fragment);
+        if (useShader) {
+            for (int i = 0; i < PARALLAX_LAYER_COUNT; i++) {
+                std::string n = std::to_string(i);
+                float tile = static_cast<float>(PARALLAX_LAYERS[i].tileSize);
+                shader.setUniform("layer" + n, layers[i]);
+                shader.setUniform("repeat" + n, sf::Glsl::Vec2(WIDTH / tile, HEIGHT / tile));
+            }
+        }
+    }
+
+    // Called once the background textures are uploaded.
+    void setThemes(sf::Texture* textures) {
+        themes = textures;
+        for (int i = 0; i < THEME_COUNT; i++) themes[i].setRepeated(true);
+        bindThemes();
+    }
+
+    // Crossfades from the theme on screen unless instant.
+    void setTheme(int theme, bool instant) {
+        from = instant ? theme : to;
+        to = theme;
+        fade = instant ? 1.0f : 0.0f;
+        if (themes) bindThemes();
+    }
+
+    // offset is the theme background's own slow scroll, cameraY the top of
+    // the world view.
+    void update(float frameTime, float offset, float cameraY) {
+        time += frameTime;
+        float blend = std::min(fade + frameTime / THEME_FADE_TIME, 1.0f);
+        bool blendChanged = blend != fade;
+        fade = blend;
+        // A finished fade leaves only the new theme, so both paths draw it alone.
+        if (fade >= 1.0f && from != to) {
+            from = to;
+            if (themes) bindThemes();
+        }
+        scroll = -offset / HEIGHT;
+        for (int i = 0; i < PARALLAX_LAYER_COUNT; i++) {
+            const ParallaxLayer& layer = PARALLAX_LAYERS[i];
+            float tile = static_cast<float>(layer.tileSize);
+            layerOffset[i] = sf::Vector2f(std::fmod(-layer.driftX * time, tile),
+                                          std::fmod(cameraY * layer.parallax - layer.driftY * time, tile));
+        }
+        if (!useShader) return;
+        if (blendChanged) shader.setUniform("blend", fade);
+        shader.setUniform("scroll", scroll);
+        for (int i = 0; i < PARALLAX_LAYER_COUNT; i++) {
+            float tile = static_cast<float>(PARALLAX_LAYERS[i].tileSize);
+            shader.setUniform(offsetNames[i], sf::Glsl::Vec2(layerOffset[i] / tile));
+        }
+    }
+
+    // Draws in screen space; returns the number of draw calls.
+    int draw(sf::RenderTarget& target) {
+        if (!themes) return 0;
+        if (useShader) {
+            setQuad(sf::Vector2f(0, 0), sf::Vector2f(1, 1), sf::Color::White);
+            target.draw(quad, &shader);
+            return 1;
+        }
+        int calls = 0;
+        bool crossfading = fade < 1.0f && from != to;
+        if (crossfading) calls += drawTheme(target, from, 255);
+        calls += drawTheme(target, to, crossfading ? static_cast<std::uint8_t>(fade * 255) : 255);
+        for (int i = 0; i < PARALLAX_LAYER_COUNT; i++) {
+            setQuad(layerOffset[i], layerOffset[i] + sf::Vector2f(WIDTH, HEIGHT), sf::Color::White);
+            target.draw(quad, &layers[i]);
+            calls++;
+        }
+        return calls;
+    }
+
+private:
+    sf::Texture* themes = nullptr;
+    sf::Texture layers[PARALLAX_LAYER_COUNT];
+    sf::Vector2f layerOffset[PARALLAX_LAYER_COUNT];
+    sf::Shader shader;
+    bool useShader = false;
+    sf::VertexArray quad;
+    int from = 0, to = 0;
+    float fade = 1.0f;
+    float time = 0;
+    float scroll = 0;
+    // Short enough for the small-string buffer, so per-frame updates never allocate.
+    const char* offsetNames[4] = {"offset0", "offset1", "offset2", "offset3"};
+    static_assert(PARALLAX_LAYER_COUNT <= 4, "name the extra layers' offset uniforms");
+
+    void bindThemes() {
+        if (!useShader) return;
+        shader.setUniform("fromTheme", themes[from]);
+        shader.setUniform("toTheme", themes[to]);
+        shader.setUniform("blend", fade);
+    }
+
+    int drawTheme(sf::RenderTarget& target, int theme, std::uint8_t alpha) {
+        sf::Vector2f size(themes[theme].getSize());
+        setQuad(sf::Vector2f(0, scroll * size.y), sf::Vector2f(size.x, (scroll + 1) * size.y),
+                sf::Color(255, 255, 255, alpha));
+        target.draw(quad, &themes[theme]);
+        return 1;
+    }
+
+    // A full-screen quad over the given texture coordinates.
+    void setQuad(sf::Vector2f texTopLeft, sf::Vector2f texBottomRight, sf::Color color) {
+        quad[0] = sf::Vertex(sf::Vector2f(0, 0), color, texTopLeft);
+        quad[1] = sf::Vertex(sf::Vector2f(WIDTH, 0), color, sf::Vector2f(texBottomRight.x, texTopLeft.y));
+        quad[2] = sf::Vertex(sf::Vector2f(WIDTH, HEIGHT), color, texBottomRight);
+        quad[3] = sf::Vertex(sf::Vector2f(0, HEIGHT), color, sf::Vector2f(texTopLeft.x, texBottomRight.y));
+    }
+
+    // Soft white flakes on a transparent tile that wraps at the edges.
+    static sf::Image snowTile(const ParallaxLayer& layer, std::uint64_t seed) {
+        sf::Image image;
+        image.create(layer.tileSize, layer.tileSize, sf::Color(255, 255, 255, 0));
+        Rng rng(seed);
+        int size = static_cast<int>(layer.tileSize);
+        int reach = static_cast<int>(std::ceil(layer.radius));
+        for (int f = 0; f < layer.flakes; f++) {
+            float cx = rng.nextFloat() * size, cy = rng.nextFloat() * size;
+            for (int dy = -reach; dy <= reach; dy++) {
+                for (int dx = -reach; dx <= reach; dx++) {
+                    int x = (static_cast<int>(cx) + dx + size) % size;
+                    int y = (static_cast<int>(cy) + dy + size) % size;
+                    float d = std::sqrt(float(dx * dx + dy * dy)) / layer.radius;
+                    if (d >= 1.0f) continue;
+                    std::uint8_t a = static_cast<std::uint8_t>(layer.alpha * (1.0f - d));
+                    sf::Color pixel = image.getPixel(x, y);
+                    if (a > pixel.a) image.setPixel(x, y, sf::Color(255, 255, 255, a));
+                }
+            }
+        }
+        return image;
+    }
+
+    // The quad's texture coordinates run 0..1 across the screen.
+    static std::string shaderSource() {
+        std::string source =
+            "uniform sampler2D fromTheme;\n"
+            "uniform sampler2D toTheme;\n"
+            "uniform float blend;\n"
+            "uniform float scroll;\n";
+        for (int i = 0; i < PARALLAX_LAYER_COUNT; i++) {
+            std::string n = std::to_string(i);
+            source += "uniform sampler2D layer" + n + ";\nuniform vec2 repeat" + n + ";\nuniform vec2 offset" + n + ";\n";
+        }
+        source +=
+            "void main() {\n"
+            "    vec2 screen = gl_TexCoord[0].xy;\n"
+            "    vec2 uv = vec2(screen.x, screen.y + scroll);\n"
+            "    vec3 color = mix(texture2D(fromTheme, uv).rgb, texture2D(toTheme, uv).rgb, blend);\n"
+            "    vec4 layer;\n";
+        for (int i = 0; i < PARALLAX_LAYER_COUNT; i++) {
+            std::string n = std::to_string(i);
+            source += "    layer = texture2D(layer" + n + ", screen * repeat" + n + " + offset" + n + ");\n"
+                      "    color = mix(color, layer.rgb, layer.a);\n";
+        }
+        source += "    gl_FragColor = vec4(color, 1.0);\n}\n";
+        return source;
+    }
+};
+
+// Every platform and its shadow as textured quads in one vertex buffer, so the
+// whole tower is a single draw call with step.png bound once.
+class PlatformRenderer {
+public:
+    PlatformRenderer(const sf::Texture& texture)
+        : texture(texture), buffer(sf::Quads, sf::VertexBuffer::Stream),
+          useBuffer(sf::VertexBuffer::isAvailable()) {
+        for (sf::Color& tint : tints) tint = sf::Color::White;
+    }
+
+    void setKinds(const SimParams& params) {
+        for (int k = 0; k < MAX_PLATFORM_KINDS; k++) tints[k] = sf::Color(params.platformKinds[k].tint);
+        dirty = true;
+    }
+
+    // Only quads whose platform was recycled, moved or crumbled since the
+    // last build are rewritten, and uploaded as one range.
+    void build(const std::vector<PlatformState>& platforms) {
+        if (built.size() != platforms.size()) {
+            vertices.assign(platforms.size() * 8, sf::Vertex());
+            built.assign(platforms.size(), Built());
+            if (useBuffer) buffer.create(vertices.size());
+            dirty = true;
+        }
+        std::size_t first = platforms.size(), last = 0;
+        for (size_t i = 0; i < platforms.size(); i++) {
+            const PlatformState& plat = platforms[i];
+            Built& b = built[i];
+            if (!dirty && b.generation == plat.generation && b.x == plat.pos.x && b.active == plat.active &&
+                b.crumbling == plat.crumbling) {
+                continue;
+            }
+            b = {plat.generation, plat.pos.x, plat.active, plat.crumbling};
+            float width = plat.active ? plat.width : 0.0f;
+            sf::Color tint = tints[plat.kind];
+            if (plat.crumbling) tint = sf::Color(tint.r * 3 / 5, tint.g * 3 / 5, tint.b * 3 / 5, tint.a);
+            writeQuad(&vertices[i * 8], plat.pos.x + 5, plat.pos.y + 5, width, sf::Color(0, 0, 0, 100));
+            writeQuad(&vertices[i * 8 + 4], plat.pos.x, plat.pos.y, width, tint);
+            first = std::min(first, i);
+            last = i;
+        }
+        if (useBuffer && first <= last) {
+            buffer.update(&vertices[first * 8], (last - first + 1) * 8, static_cast<unsigned>(first * 8));
+        }
+        dirty = false;
+    }
+
+    // Call after the simulation is reset; generations restart from zero.
+    void invalidate() { dirty = true; }
+
+    void draw(sf::RenderTarget& target) const {
+        if (useBuffer) target.draw(buffer, &texture);
+        else target.draw(vertices.data(), vertices.size(), sf::Quads, &texture);
+    }
+
+private:
+    struct Built {
+        std::uint32_t generation = 0;
+        float x = 0;
+        bool active = true;
+        bool crumbling = false;
+    };
+
+    const sf::Texture& texture;
+    std::vector<sf::Vertex> vertices;
+    std::vector<Built> built;
+    sf::Color tints[MAX_PLATFORM_KINDS];
+    sf::VertexBuffer buffer;
+    bool useBuffer;
+    bool dirty = true;
+
+    void writeQuad(sf::Vertex* quad, float x, float y, float width, sf::Color color) {
+        sf::Vector2u size = texture.getSize();
+        quad[0] = sf::Vertex(sf::Vector2f(x, y), color, sf::Vector2f(0, 0));
+        quad[1] = sf::Vertex(sf::Vector2f(x + width, y), color, sf::Vector2f(size.x, 0));
+        quad[2] = sf::Vertex(sf::Vector2f(x + width, y + PLATFORM_HEIGHT), color, sf::Vector2f(size.x, size.y));
+        quad[3] = sf::Vertex(sf::Vector2f(x, y + PLATFORM_HEIGHT), color, sf::Vector2f(0, size.y));
+    }
+};
+
+// One quad per pickup still waiting over its platform, in its kind's tint.
+class PickupRenderer {
+public:
+    sf::VertexArray vertices;
+
+    PickupRenderer() : vertices(sf::Quads) {
+        for (sf::Color& tint : tints) tint = sf::Color::White;
+    }
+
+    void setKinds(const SimParams& params) {
+        for (int k = 0; k < MAX_PICKUP_KINDS; k++) tints[k] = sf::Color(params.pickupKinds[k].tint);
+    }
+
+    void build(const std::vector<PlatformState>& platforms) {
+        // clear() keeps the capacity, so steady state never allocates.
+        vertices.clear();
+        for (const PlatformState& plat : platforms) {
+            if (plat.pickup < 0 || !plat.active) continue;
+            AABB b = plat.pickupBounds();
+            sf::Color color = tints[plat.pickup];
+            vertices.append(sf::Vertex(sf::Vector2f(b.left, b.top), color));
+            vertices.append(sf::Vertex(sf::Vector2f(b.right(), b.top), color));
+            vertices.append(sf::Vertex(sf::Vector2f(b.right(), b.bottom()), color));
+            vertices.append(sf::Vertex(sf::Vector2f(b.left, b.bottom()), color));
+        }
+    }
+
+private:
+    sf::Color tints[MAX_PICKUP_KINDS];
+};
+
+// Builds one quad per live particle so the whole pool is a single draw call.
+class ParticleRenderer {
+public:
+    sf::VertexArray vertices;
+
+    ParticleRenderer() : vertices(sf::Quads) {}
+
+    void build(const ParticlePool& pool) {
+        // Shrinking keeps the vector's capacity, so steady state never allocates.
+        vertices.resize(static_cast<std::size_t>(pool.count) * 4);
+        for (int i = 0; i < pool.count; i++) {
+            float d = pool.size[i] * 2;
+            sf::Color color(pool.r[i], pool.g[i], pool.b[i], pool.alpha(i));
+            sf::Vertex* quad = &vertices[static_cast<std::size_t>(i) * 4];
+            quad[0] = sf::Vertex(sf::Vector2f(pool.x[i], pool.y[i]), color);
+            quad[1] = sf::Vertex(sf::Vector2f(pool.x[i] + d, pool.y[i]), color);
+            quad[2] = sf::Vertex(sf::Vector2f(pool.x[i] + d, pool.y[i] + d), color);
+            quad[3] = sf::Vertex(sf::Vector2f(pool.x[i], pool.y[i] + d), color);
+        }
+    }
+};
+
+// F3 overlay: frame-time graph against the 60 FPS budget, per-phase p50/p99,
+// draw calls and particle count. Stats refresh four times a second.
+class ProfilerOverlay {
+public:
+    bool visible = false;
+
+    ProfilerOverlay(const sf::Font& font) : graph(sf::Quads, PROFILE_FRAME_HISTORY * 4 + 4) {
+        panel.setFillColor(sf::Color(0, 0, 0, 170));
+        panel.setPosition(4, 84);
+        panel.setSize(sf::Vector2f(WIDTH - 8, 250));
+        stats.setFont(font);
+        stats.setCharacterSize(11);
+        stats.setFillColor(sf::Color::White);
+        stats.setPosition(10, 88);
+    }
+
+    void update(float frameTime) {
+        refreshTimer -= frameTime;
+        if (refreshTimer > 0) return;
+        refreshTimer = 0.25f;
+
+        Profiler& profiler = Profiler::instance();
+        PhaseStats phaseStats[PHASE_COUNT];
+        profiler.computeStats(phaseStats);
+        char buffer[1024];
+        int used = std::snprintf(buffer, sizeof(buffer), "%-18s %7s %7s\n", "phase (ms)", "p50", "p99");
+        for (int p = 0; p < PHASE_COUNT && used < static_cast<int>(sizeof(buffer)); p++) {
+            used += std::snprintf(buffer + used, sizeof(buffer) - used, "%-18s %7.3f %7.3f\n",
+                                  phaseName(static_cast<Phase>(p)), phaseStats[p].p50Ms, phaseStats[p].p99Ms);
+        }
+        if (used < static_cast<int>(sizeof(buffer))) {
+            std::snprintf(buffer + used, sizeof(buffer) - used, "draw calls %d  particles %d  (F4: trace)",
+                          profiler.lastDrawCalls(), profiler.lastParticles());
+        }
+        stats.setString(buffer);
+
+        // One bar per frame, 3 px per ms; the last quad is the 16.7 ms line.
+        const float left = 150, bottom = 328, budgetMs = 1000.0f / 60.0f;
+        int frames = profiler.frameHistory();
+        for (int i = 0; i < PROFILE_FRAME_HISTORY; i++) {
+            float ms = i < frames ? profiler.frameTime(i) : 0.0f;
+            float h = std::min(ms * 3.0f, 60.0f);
+            sf::Color color = ms > budgetMs * 1.5f ? sf::Color::Red : ms > budgetMs ? sf::Color::Yellow : sf::Color::Green;
+            sf::Vertex* quad = &graph[static_cast<std::size_t>(i) * 4];
+            float x = left + i;
+            quad[0] = sf::Vertex(sf::Vector2f(x, bottom - h), color);
+            quad[1] = sf::Vertex(sf::Vector2f(x + 1, bottom - h), color);
+            quad[2] = sf::Vertex(sf::Vector2f(x + 1, bottom), color);
+            quad[3] = sf::Vertex(sf::Vector2f(x, bottom), color);
+        }
+        sf::Vertex* line = &graph[static_cast<std::size_t>(PROFILE_FRAME_HISTORY) * 4];
+        float y = bottom - budgetMs * 3.0f;
+        sf::Color white(255, 255, 255, 160);
+        line[0] = sf::Vertex(sf::Vector2f(left, y), white);
+        line[1] = sf::Vertex(sf::Vector2f(left + PROFILE_FRAME_HISTORY, y), white);
+        line[2] = sf::Vertex(sf::Vector2f(left + PROFILE_FRAME_HISTORY, y + 1), white);
+        line[3] = sf::Vertex(sf::Vector2f(left, y + 1), white);
+    }
+
+    // Returns the number of draw calls issued.
+    int draw(sf::RenderTarget& target) const {
+        target.draw(panel);
+        target.draw(stats);
+        target.draw(graph);
+        return 3;
+    }
+
+private:
+    sf::RectangleShape panel;
+    sf::Text stats;
+    sf::VertexArray graph;
+    float refreshTimer = 0;
+};
+
+class Player {
+public:
+    sf::Sprite characterSprite;
+
+    void setTexture(const sf::Texture& texture) {
+        characterSprite.setTexture(texture, true);
+        sf::Vector2u textureSize = texture.getSize();
+        characterSprite.setScale(PLAYER_SIZE / textureSize.x, PLAYER_SIZE / textureSize.y);
+    }
+
+    // A negative x scale mirrors around the sprite origin, so shift by the
+    // width to keep the sprite over the simulated bounds.
+    void sync(const PlayerState& state) {
+        float scaleX = std::abs(characterSprite.getScale().x);
+        characterSprite.setScale(state.facingRight ? scaleX : -scaleX, characterSprite.getScale().y);
+        characterSprite.setPosition(state.facingRight ? state.pos.x : state.pos.x + PLAYER_SIZE, state.pos.y);
+    }
+};
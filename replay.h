@@ -0,0 +1,328 @@
+#pragma once
+
+#include "sim.h"
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// .icyrec layout, little-endian:
+//   "ICYR", u16 version, u16 tick rate, u64 seed, SimParams (see writeParams)
+//   u32 run count, then per run: varint tick count, u8 input bits
+//   footer: u64 ticks, i32 score, f32 player x, f32 player y
+// Inputs are stored as runs of identical bitmasks, so a held key costs two
+// or three bytes however long it is held.
+const char REPLAY_MAGIC[4] = {'I', 'C', 'Y', 'R'};
+// Version 2: towers come from the chunked generator.
+// Version 3: jumps fire on Space presses (INPUT_JUMP_PRESSED), not while held.
+// Version 4: SimParams carry the platform kinds and pickups.
+// Version 5: landings are swept along the tick's fall.
+// Version 6: ice steering is scaled to the tick rate.
+// Version 7: the camera's scroll is scaled to the tick rate.
+// Version 8: towers place platforms anywhere a jump's fall crosses.
+// Version 9: gravity is integrated exactly; landings and the camera are
+// resolved within the tick.
+const std::uint16_t REPLAY_VERSION = 9;
+
+struct ReplaySummary {
+    std::uint64_t ticks = 0;
+    std::int32_t score = 0;
+    float playerX = 0;
+    float playerY = 0;
+
+    static ReplaySummary of(const Simulation& sim) {
+        return {sim.ticks, sim.score, sim.player.pos.x, sim.player.pos.y};
+    }
+
+    // Bit-exact: a replay either reproduces the run or it does not.
+    bool operator==(const ReplaySummary& o) const {
+        return ticks == o.ticks && score == o.score &&
+               std::memcmp(&playerX, &o.playerX, sizeof(float)) == 0 &&
+               std::memcmp(&playerY, &o.playerY, sizeof(float)) == 0;
+    }
+};
+
+class ByteWriter {
+public:
+    std::vector<std::uint8_t> bytes;
+
+    void u8(std::uint8_t v) { bytes.push_back(v); }
+    void u16(std::uint16_t v) { put(v, 2); }
+    void u32(std::uint32_t v) { put(v, 4); }
+    void u64(std::uint64_t v) { put(v, 8); }
+    void i32(std::int32_t v) { put(static_cast<std::uint32_t>(v), 4); }
+    void f32(float v) {
+        std::uint32_t bits;
+        std::memcpy(&bits, &v, 4);
+        put(bits, 4);
+    }
+    void varint(std::uint64_t v) {
+        while (v >= 0x80) {
+            bytes.push_back(static_cast<std::uint8_t>(v | 0x80));
+            v >>= 7;
+        }
+        bytes.push_back(static_cast<std::uint8_t>(v));
+    }
+
+private:
+    void put(std::uint64_t v, int n) {
+        for (int i = 0; i < n; i++) bytes.push_back(static_cast<std::uint8_t>(v >> (8 * i)));
+    }
+};
+
+// Bounds-checked reader; any overrun sets ok to false and reads zeros.
+class ByteReader {
+public:
+    bool ok = true;
+
+    ByteReader(const std::uint8_t* data, std::size_t size) : data(data), size(size) {}
+
+    std::uint8_t u8() { return static_cast<std::uint8_t>(get(1)); }
+    std::uint16_t u16() { return static_cast<std::uint16_t>(get(2)); }
+    std::uint32_t u32() { return static_cast<std::uint32_t>(get(4)); }
+    std::uint64_t u64() { return get(8); }
+    std::int32_t i32() { return static_cast<std::int32_t>(u32()); }
+    float f32() {
+        std::uint32_t bits = u32();
+        float v;
+        std::memcpy(&v, &bits, 4);
+        return v;
+    }
+    std::uint64_t varint() {
+        std::uint64_t v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            std::uint8_t b = u8();
+            v |= std::uint64_t(b & 0x7F) << shift;
+            if (!(b & 0x80)) return v;
+        }
+        ok = false;
+        return 0;
+    }
+    bool atEnd() const { return pos == size; }
+
+private:
+    const std::uint8_t* data;
+    std::size_t size;
+    std::size_t pos = 0;
+
+    std::uint64_t get(int n) {
+        if (!ok || size - pos < static_cast<std::size_t>(n)) {
+            ok = false;
+            return 0;
+        }
+        std::uint64_t v = 0;
+        for (int i = 0; i < n; i++) v |= std::uint64_t(data[pos++]) << (8 * i);
+        return v;
+    }
+};
+
+inline void writeParams(ByteWriter& w, const SimParams& p) {
+    w.f32(p.gravity);
+    w.f32(p.jumpForce);
+    w.f32(p.wallJumpForce);
+    w.f32(p.doubleJumpForce);
+    w.f32(p.maxSpeed);
+    w.f32(p.platformSpacing);
+    w.f32(p.wallBounceDamping);
+    w.i32(p.platformCount);
+    w.u8(static_cast<std::uint8_t>(p.platformKindCount));
+    for (int k = 0; k < p.platformKindCount; k++) {
+        const PlatformKind& kind = p.platformKinds[k];
+        for (float v : {kind.weight, kind.fromHeight, kind.moveSpeed, kind.moveRange, kind.crumbleTime,
+                        kind.friction, kind.bounce}) {
+            w.f32(v);
+        }
+        w.u32(kind.tint);
+    }
+    w.u8(static_cast<std::uint8_t>(p.pickupKindCount));
+    for (int k = 0; k < p.pickupKindCount; k++) {
+        const PickupKind& kind = p.pickupKinds[k];
+        for (float v : {kind.chance, kind.fromHeight, kind.duration, kind.speedScale}) w.f32(v);
+        w.i32(kind.extraJumps);
+        w.u32(kind.tint);
+    }
+}
+
+inline SimParams readParams(ByteReader& r) {
+    SimParams p;
+    p.gravity = r.f32();
+    p.jumpForce = r.f32();
+    p.wallJumpForce = r.f32();
+    p.doubleJumpForce = r.f32();
+    p.maxSpeed = r.f32();
+    p.platformSpacing = r.f32();
+    p.wallBounceDamping = r.f32();
+    p.platformCount = r.i32();
+    if (p.platformCount < 2 || p.platformCount > MAX_PLATFORM_COUNT) r.ok = false;
+    p.platformKindCount = r.u8();
+    if (p.platformKindCount < 1 || p.platformKindCount > MAX_PLATFORM_KINDS) r.ok = false;
+    for (int k = 0; k < p.platformKindCount && r.ok; k++) {
+        PlatformKind& kind = p.platformKinds[k];
+        for (float* v : {&kind.weight, &kind.fromHeight, &kind.moveSpeed, &kind.moveRange, &kind.crumbleTime,
+                         &kind.friction, &kind.bounce}) {
+            *v = r.f32();
+        }
+        kind.tint = r.u32();
+    }
+    p.pickupKindCount = r.u8();
+    if (p.pickupKindCount > MAX_PICKUP_KINDS) r.ok = false;
+    for (int k = 0; k < p.pickupKindCount && r.ok; k++) {
+        PickupKind& kind = p.pickupKinds[k];
+        for (float* v : {&kind.chance, &kind.fromHeight, &kind.duration, &kind.speedScale}) *v = r.f32();
+        kind.extraJumps = r.i32();
+        kind.tint = r.u32();
+    }
+    return p;
+}
+
+// Collects the per-tick input of one run. Storage is reserved up front so
+// recording does not allocate during normal play.
+class InputRecorder {
+public:
+    InputRecorder() { runs.bytes.reserve(64 * 1024); }
+
+    void begin(std::uint64_t runSeed, int runTickRate, const SimParams& runParams) {
+        seed = runSeed;
+        tickRate = runTickRate;
+        params = runParams;
+        runs.bytes.clear();
+        runCount = 0;
+        current = 0;
+        runLength = 0;
+        recording = true;
+    }
+
+    bool active() const { return recording; }
+    std::uint64_t runSeed() const { return seed; }
+
+    // Drops the run in progress; nothing is recorded until the next begin().
+    void stop() { recording = false; }
+
+    void record(std::uint8_t input) {
+        if (!recording) return;
+        if (runLength > 0 && input == current) {
+            runLength++;
+            return;
+        }
+        flushRun();
+        current = input;
+        runLength = 1;
+    }
+
+    // Writes the run with sim's current state as the expected outcome.
+    bool save(const std::string& path, const Simulation& sim) {
+        flushRun();
+        recording = false;
+        ReplaySummary summary = ReplaySummary::of(sim);
+
+        ByteWriter w;
+        for (char c : REPLAY_MAGIC) w.u8(static_cast<std::uint8_t>(c));
+        w.u16(REPLAY_VERSION);
+        w.u16(static_cast<std::uint16_t>(tickRate));
+        w.u64(seed);
+        writeParams(w, params);
+        w.u32(runCount);
+        w.bytes.insert(w.bytes.end(), runs.bytes.begin(), runs.bytes.end());
+        w.u64(summary.ticks);
+        w.i32(summary.score);
+        w.f32(summary.playerX);
+        w.f32(summary.playerY);
+
+        std::ofstream file(path, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(w.bytes.data()), w.bytes.size());
+        return static_cast<bool>(file);
+    }
+
+private:
+    ByteWriter runs;
+    std::uint32_t runCount = 0;
+    std::uint64_t seed = 0;
+    int tickRate = TICK_RATE;
+    SimParams params;
+    std::uint8_t current = 0;
+    std::uint64_t runLength = 0;
+    bool recording = false;
+
+    void flushRun() {
+        if (runLength == 0) return;
+        runs.varint(runLength);
+        runs.u8(current);
+        runCount++;
+        runLength = 0;
+    }
+};
+
+class Replay {
+public:
+    std::uint64_t seed = 0;
+    int tickRate = TICK_RATE;
+    SimParams params;
+    std::vector<std::uint64_t> runLengths;
+    std::vector<std::uint8_t> runInputs;
+    ReplaySummary expected;
+
+    bool load(const std::string& path, std::string& error) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            error = "cannot open " + path;
+            return false;
+        }
+        std::vector<std::uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        ByteReader r(data.data(), data.size());
+        char magic[4];
+        for (char& c : magic) c = static_cast<char>(r.u8());
+        if (!r.ok || std::memcmp(magic, REPLAY_MAGIC, 4) != 0 || r.u16() != REPLAY_VERSION) {
+            error = path + " is not a version " + std::to_string(REPLAY_VERSION) + " recording";
+            return false;
+        }
+        tickRate = r.u16();
+        seed = r.u64();
+        params = readParams(r);
+        std::uint32_t runCount = r.u32();
+        runLengths.clear();
+        runInputs.clear();
+        for (std::uint32_t i = 0; i < runCount && r.ok; i++) {
+            runLengths.push_back(r.varint());
+            runInputs.push_back(r.u8());
+        }
+        expected.ticks = r.u64();
+        expected.score = r.i32();
+        expected.playerX = r.f32();
+        expected.playerY = r.f32();
+        if (!r.ok || !r.atEnd() || tickRate <= 0) {
+            error = path + " is truncated or corrupt";
+            return false;
+        }
+        return true;
+    }
+
+    // Re-runs the recording headless, as fast as the CPU allows.
+    ReplaySummary play() const {
+        Simulation sim(params);
+        sim.reset(seed);
+        const float deltaTime = 1.0f / tickRate;
+        for (size_t i = 0; i < runLengths.size(); i++) {
+            for (std::uint64_t t = 0; t < runLengths[i] && !sim.gameOver; t++) sim.step(runInputs[i], deltaTime);
+        }
+        return ReplaySummary::of(sim);
+    }
+};
+
+// Loads and replays one file; message describes a failure.
+inline bool verifyReplay(const std::string& path, std::string& message, std::uint64_t& ticks) {
+    Replay replay;
+    ticks = 0;
+    if (!replay.load(path, message)) return false;
+    ReplaySummary actual = replay.play();
+    ticks = actual.ticks;
+    if (actual == replay.expected) return true;
+    std::ostringstream ss;
+    ss << path << ": expected score " << replay.expected.score << " at (" << replay.expected.playerX << ", "
+       << replay.expected.playerY << ") after " << replay.expected.ticks << " ticks, got score " << actual.score
+       << " at (" << actual.playerX << ", " << actual.playerY << ") after " << actual.ticks << " ticks";
+    message = ss.str();
+    return false;
+}
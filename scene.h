@@ -0,0 +1,53 @@
+#pragma once
+
+// What the game window is showing. Scenes stack: Paused and GameOver are
+// drawn over the Playing scene beneath them, while Menu and Playing cover
+// the whole window.
+enum class Scene { Menu, Playing, Paused, GameOver };
+
+// Frame cap for every scene but Playing when the game runs uncapped (--fps=0).
+const int IDLE_FRAME_RATE = 60;
+
+inline bool coversWindow(Scene scene) {
+    return scene == Scene::Menu || scene == Scene::Playing;
+}
+
+// Fixed-capacity stack, so changing scenes never allocates.
+class SceneStack {
+public:
+    static const int CAPACITY = 4;
+
+    explicit SceneStack(Scene first) { scenes[0] = first; }
+
+    Scene top() const { return scenes[count - 1]; }
+    int size() const { return count; }
+    Scene operator[](int i) const { return scenes[i]; }
+
+    void push(Scene scene) {
+        if (count < CAPACITY) scenes[count++] = scene;
+    }
+
+    // The bottom scene stays.
+    void pop() {
+        if (count > 1) count--;
+    }
+
+    // Drops every scene and starts over with this one.
+    void reset(Scene scene) {
+        scenes[0] = scene;
+        count = 1;
+    }
+
+    // The lowest scene that needs drawing: the topmost one that covers the
+    // window, or the bottom of the stack.
+    int firstVisible() const {
+        for (int i = count - 1; i > 0; i--) {
+            if (coversWindow(scenes[i])) return i;
+        }
+        return 0;
+    }
+
+private:
+    Scene scenes[CAPACITY];
+    int count = 1;
+};
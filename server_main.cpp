@@ -0,0 +1,172 @@
+#include "net_socket.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Headless race server. Runs every race on one thread at the tick rate and
+// prints load statistics every few seconds. --bots and --spectators start
+// scripted clients that connect over localhost, for load tests:
+//   ./icy_tower_server --bots=200 --spectators=50 --seconds=30
+
+struct ServerConfig {
+    unsigned short port = NET_PORT;
+    int racersPerRace = 2;
+    int tickRate = TICK_RATE;
+    int bots = 0;
+    int spectators = 0;
+    int seconds = 0;
+    int reportSeconds = 5;
+};
+
+using Clock = std::chrono::steady_clock;
+
+// Scripted clients on their own thread, ticking at the server's rate.
+static void runBots(const ServerConfig& config, std::atomic<bool>& running) {
+    NetAddress server = toNetAddress(sf::IpAddress::LocalHost, config.port);
+    struct Bot {
+        std::unique_ptr<RaceConnection> connection;
+        Simulation local;
+        bool jumpHeld = false;
+    };
+    std::vector<Bot> bots(config.bots + config.spectators);
+    for (int i = 0; i < static_cast<int>(bots.size()); i++) {
+        NetRole role = i < config.bots ? ROLE_RACER : ROLE_SPECTATOR;
+        bots[i].connection.reset(new RaceConnection(role, server));
+        if (!bots[i].connection->open()) {
+            std::cerr << "Failed to open a bot socket." << std::endl;
+            return;
+        }
+    }
+
+    const float deltaTime = 1.0f / config.tickRate;
+    const Clock::duration step = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(deltaTime));
+    Clock::time_point due = Clock::now();
+    std::size_t first = 0;
+    while (running.load(std::memory_order_relaxed)) {
+        // Rotate who goes first so no bot is always at the back of the burst.
+        first = (first + 1) % bots.size();
+        for (std::size_t i = 0; i < bots.size(); i++) {
+            Bot& bot = bots[(first + i) % bots.size()];
+            RaceConnection& connection = *bot.connection;
+            if (connection.poll(bot.local)) bot.jumpHeld = false;
+            if (connection.client.role == ROLE_RACER) {
+                for (int n = connection.client.pace(); n > 0 && !bot.local.gameOver; n--) {
+                    connection.client.step(bot.local, scriptedInput(bot.local, bot.jumpHeld), deltaTime);
+                }
+            }
+            connection.send(bot.local);
+        }
+        due += step;
+        std::this_thread::sleep_until(due);
+    }
+    for (Bot& bot : bots) bot.connection->leave();
+}
+
+static int runServer(const ServerConfig& config) {
+    NetSocket socket;
+    if (!socket.bind(config.port)) {
+        std::cerr << "Failed to bind UDP port " << config.port << "." << std::endl;
+        return 1;
+    }
+    RaceServer server(SimParams(), config.tickRate, config.racersPerRace);
+    std::cout << "Listening on UDP port " << config.port << ", " << config.racersPerRace
+              << " racers per race." << std::endl;
+
+    std::atomic<bool> running{true};
+    std::thread bots;
+    if (config.bots + config.spectators > 0) bots = std::thread([&] { runBots(config, running); });
+
+    const Clock::duration step =
+        std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / config.tickRate));
+    auto send = [&](NetAddress to, const std::uint8_t* data, std::size_t size) { socket.send(to, data, size); };
+    auto receive = [&](NetAddress from, const std::uint8_t* data, std::size_t size) { server.receive(from, data, size); };
+    double busyUs = 0;
+    std::vector<double> tickUs;
+    tickUs.reserve(config.tickRate * config.reportSeconds);
+    RaceServer::Stats last;
+    Clock::time_point start = Clock::now();
+    Clock::time_point due = start;
+    Clock::time_point reportAt = start + std::chrono::seconds(config.reportSeconds);
+    while (config.seconds == 0 || Clock::now() - start < std::chrono::seconds(config.seconds)) {
+        Clock::time_point tickStart = Clock::now();
+        socket.receiveAll(receive);
+        server.tick(send);
+        tickUs.push_back(std::chrono::duration<double, std::micro>(Clock::now() - tickStart).count());
+        busyUs += tickUs.back();
+
+        if (Clock::now() >= reportAt) {
+            // Busy time as a share of wall time is the load on this core.
+            std::sort(tickUs.begin(), tickUs.end());
+            double seconds = config.reportSeconds;
+            const RaceServer::Stats& s = server.stats;
+            std::cout << "races " << s.races << ", racers " << s.racers << ", spectators " << s.spectators
+                      << " | tick p50 " << tickUs[tickUs.size() / 2] << " us, p99 "
+                      << tickUs[tickUs.size() * 99 / 100] << " us, load "
+                      << 100.0 * busyUs / (seconds * 1e6) << "% of one core"
+                      << " | in " << (s.bytesIn - last.bytesIn) / 1024.0 / seconds << " KB/s, out "
+                      << (s.bytesOut - last.bytesOut) / 1024.0 / seconds << " KB/s"
+                      << " | late inputs " << s.guessedInputs - last.guessedInputs << std::endl;
+            last = s;
+            tickUs.clear();
+            busyUs = 0;
+            reportAt += std::chrono::seconds(config.reportSeconds);
+        }
+
+        // Keep draining the socket until the next tick; a whole tick's worth
+        // of datagrams at once can overflow the kernel's receive buffer.
+        due += step;
+        if (due < Clock::now()) due = Clock::now();
+        while (Clock::now() < due) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            Clock::time_point drainStart = Clock::now();
+            socket.receiveAll(receive);
+            busyUs += std::chrono::duration<double, std::micro>(Clock::now() - drainStart).count();
+        }
+    }
+
+    running.store(false, std::memory_order_relaxed);
+    if (bots.joinable()) bots.join();
+    return 0;
+}
+
+static bool parseArg(const char* arg, const char* name, std::string& value) {
+    size_t len = std::strlen(name);
+    if (std::strncmp(arg, name, len) != 0 || arg[len] != '=') return false;
+    value = arg + len + 1;
+    return true;
+}
+
+static ServerConfig parseArgs(int argc, char** argv) {
+    ServerConfig config;
+    for (int i = 1; i < argc; i++) {
+        std::string v;
+        if (parseArg(argv[i], "--port", v)) config.port = static_cast<unsigned short>(std::atoi(v.c_str()));
+        else if (parseArg(argv[i], "--racers", v)) config.racersPerRace = std::atoi(v.c_str());
+        else if (parseArg(argv[i], "--tick-rate", v)) config.tickRate = std::atoi(v.c_str());
+        else if (parseArg(argv[i], "--bots", v)) config.bots = std::atoi(v.c_str());
+        else if (parseArg(argv[i], "--spectators", v)) config.spectators = std::atoi(v.c_str());
+        else if (parseArg(argv[i], "--seconds", v)) config.seconds = std::atoi(v.c_str());
+        else {
+            std::cerr << "Unknown argument " << argv[i] << "." << std::endl;
+            std::cerr << "Usage: icy_tower_server [--port=N] [--racers=N] [--tick-rate=N]\n"
+                         "       [--bots=N] [--spectators=N] [--seconds=N]" << std::endl;
+            exit(1);
+        }
+    }
+    if (config.racersPerRace < 1 || config.racersPerRace > MAX_RACERS || config.tickRate <= 0) {
+        std::cerr << "Need 1 to " << MAX_RACERS << " racers per race and a positive tick rate." << std::endl;
+        exit(1);
+    }
+    return config;
+}
+
+int main(int argc, char** argv) {
+    return runServer(parseArgs(argc, argv));
+}
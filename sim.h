@@ -0,0 +1,887 @@
+#pragma once
+
+#include "profiler.h"
+#include "simd.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+const int WIDTH = 400;
+const int HEIGHT = 600;
+const int PLATFORM_COUNT = 12;
+// Bound on --platforms and on the count read back from a recording.
+const int MAX_PLATFORM_COUNT = 4096;
+const float GRAVITY = 0.35f;
+const float JUMP_FORCE = -12.0f;
+const float WALL_JUMP_FORCE = -8.0f;
+const float PLAYER_MAX_SPEED = 4.0f;
+const float DOUBLE_JUMP_FORCE = -10.0f;
+const float PLATFORM_SPACING = 80.0f;
+const float WALL_BOUNCE_DAMPING = 0.7f;
+
+const float PLAYER_SIZE = 40.0f;
+const float PLATFORM_WIDTH = 120.0f;
+const float PLATFORM_HEIGHT = 15.0f;
+const float GROUND_WIDTH = 400.0f;
+const int MAX_BURSTS = 4;
+const int TICK_RATE = 60;
+const int MAX_STEPS_PER_FRAME = 5;
+const int MAX_PLATFORM_KINDS = 8;
+const int MAX_PICKUP_KINDS = 4;
+const float PICKUP_SIZE = 20.0f;
+// Gap between a pickup and the top of the platform it sits over.
+const float PICKUP_HOVER = 10.0f;
+// Falling feet up to this far into a platform still land on top.
+const float LANDING_BAND = 10.0f;
+
+// Input is passed to the simulation as a bitmask so it can run without a window.
+enum InputBits : std::uint8_t {
+    INPUT_LEFT = 1 << 0,
+    INPUT_RIGHT = 1 << 1,
+    INPUT_JUMP = 1 << 2,
+    // Space went down since the previous tick, even if it was released again
+    // before the tick ran. Jumps only fire on a press; holding Space jumps
+    // once. Simulation::step also derives it from an INPUT_JUMP rising edge.
+    INPUT_JUMP_PRESSED = 1 << 3
+};
+
+struct Vec2 {
+    float x = 0.0f;
+    float y = 0.0f;
+};
+
+struct AABB {
+    float left, top, width, height;
+
+    float right() const { return left + width; }
+    float bottom() const { return top + height; }
+
+    // Same strict test as sf::FloatRect::intersects.
+    bool intersects(const AABB& other) const {
+        return std::max(left, other.left) < std::min(right(), other.right()) &&
+               std::max(top, other.top) < std::min(bottom(), other.bottom());
+    }
+};
+
+// splitmix64; every simulation owns one so parallel games never share state.
+class Rng {
+public:
+    explicit Rng(std::uint64_t seed = 1) : state(seed) {}
+
+    void reseed(std::uint64_t seed) { state = seed; }
+
+    std::uint64_t next() {
+        std::uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    int nextInt(int bound) { return static_cast<int>(next() % static_cast<std::uint64_t>(bound)); }
+
+    // Uniform in [0, 1).
+    float nextFloat() { return static_cast<float>(next() >> 40) * (1.0f / 16777216.0f); }
+
+private:
+    std::uint64_t state;
+};
+
+// One kind of platform, as listed in platforms.cfg (content.h). Behaviours
+// combine: a kind can move and crumble at once.
+struct PlatformKind {
+    float weight = 1;         // odds against the other kinds allowed at a height
+    float fromHeight = 0;     // climbed pixels before it appears
+    float moveSpeed = 0;      // px per 60 Hz tick
+    float moveRange = 0;      // px either side of where it was placed
+    float crumbleTime = 0;    // seconds after the first landing; 0 never
+    float friction = 1;       // share of the steering applied per 60 Hz tick; 1 is instant
+    float bounce = 0;         // landing launches the player at jumpForce times this
+    std::uint32_t tint = 0xFFFFFFFF;  // RGBA
+};
+
+// A timed power-up hovering over a platform.
+struct PickupKind {
+    float chance = 0;         // per platform
+    float fromHeight = 0;
+    float duration = 0;       // seconds
+    float speedScale = 1;     // multiplies maxSpeed while active
+    int extraJumps = 0;       // air jumps on top of the double jump while active
+    std::uint32_t tint = 0xFFFFFFFF;
+};
+
+// Tunables that used to be hard-wired constants; the batch runner overrides them.
+struct SimParams {
+    float gravity = GRAVITY;
+    float jumpForce = JUMP_FORCE;
+    float wallJumpForce = WALL_JUMP_FORCE;
+    float doubleJumpForce = DOUBLE_JUMP_FORCE;
+    float maxSpeed = PLAYER_MAX_SPEED;
+    float platformSpacing = PLATFORM_SPACING;
+    float wallBounceDamping = WALL_BOUNCE_DAMPING;
+    int platformCount = PLATFORM_COUNT;
+    // Kind 0 is also the ground. One plain kind and no pickups are the
+    // original game's rules.
+    int platformKindCount = 1;
+    PlatformKind platformKinds[MAX_PLATFORM_KINDS];
+    int pickupKindCount = 0;
+    PickupKind pickupKinds[MAX_PICKUP_KINDS];
+
+    bool hasContent() const { return platformKindCount > 1 || pickupKindCount > 0; }
+
+    // The same tunables under the original rules.
+    SimParams classic() const {
+        SimParams p = *this;
+        p.platformKindCount = 1;
+        p.platformKinds[0] = PlatformKind();
+        p.pickupKindCount = 0;
+        return p;
+    }
+};
+
+struct PlayerState {
+    Vec2 pos;
+    Vec2 vel;
+    bool canJump = true;
+    bool canDoubleJump = false;
+    bool isWallJumping = false;
+    bool facingRight = true;
+    Vec2 lastWall;
+    // Air jumps from pickups, left after the double jump.
+    int extraJumps = 0;
+
+    AABB bounds() const { return {pos.x, pos.y, PLAYER_SIZE, PLAYER_SIZE}; }
+};
+
+struct PlatformState {
+    Vec2 pos;
+    float width = PLATFORM_WIDTH;
+    std::uint8_t kind = 0;
+    // Pickup kind waiting over it, or -1.
+    std::int8_t pickup = -1;
+    bool active = true;
+    bool scored = false;
+    // Landed on; gone once its kind's crumbleTime is up.
+    bool crumbling = false;
+    // Index into Simulation::movers, or -1 if it does not move.
+    int mover = -1;
+    // Bumped on every recycle so renderers know not to interpolate across it.
+    std::uint32_t generation = 0;
+
+    AABB bounds() const { return {pos.x, pos.y, width, PLATFORM_HEIGHT}; }
+
+    AABB pickupBounds() const {
+        return {pos.x + width / 2 - PICKUP_SIZE / 2, pos.y - PICKUP_HOVER - PICKUP_SIZE, PICKUP_SIZE, PICKUP_SIZE};
+    }
+};
+
+// Where the front-end should emit dust this step (landings and wall bounces).
+struct ParticleBurst {
+    float x, y, size;
+};
+
+const int TOWER_CHUNK_SIZE = 16;
+// Difficulty ramps from the base spacing and width at the ground to their
+// limits this many pixels up the tower.
+const float DIFFICULTY_HEIGHT = 20000.0f;
+const float MAX_SPACING_SCALE = 1.5f;
+const float MIN_WIDTH_SCALE = 0.6f;
+
+struct PlatformSpec {
+    float x, y, width;
+    std::uint8_t kind = 0;
+    std::int8_t pickup = -1;
+};
+
+inline PlatformSpec groundSpec() { return {WIDTH / 2.0f - 200, HEIGHT - 15.0f, GROUND_WIDTH}; }
+
+struct TowerChunk {
+    std::uint64_t seed = 0;
+    int index = -1;
+    PlatformSpec platforms[TOWER_CHUNK_SIZE];
+};
+
+// Share of a step, 0 to 1, at which feet moving by a*s + b*s*s have fallen
+// through d. Written so neither branch cancels, and b may be zero.
+inline float fallShare(float a, float b, float d) {
+    float root = std::sqrt(std::max(a * a + 4 * b * d, 0.0f));
+    float s = a >= 0 ? 2 * d / (a + root) : (root - a) / (2 * b);
+    return std::min(std::max(s, 0.0f), 1.0f);
+}
+
+// Longest slice the camera eases over; a step is split into whole slices.
+const float CAMERA_STEP = 1.0f / 120;
+
+inline int cameraSlices(float deltaTime) {
+    return std::max(1, static_cast<int>(std::ceil(deltaTime / CAMERA_STEP - 0.001f)));
+}
+
+// Simulates the best-case jump from standing anywhere on `from`: jump at
+// once, double jump at the apex, steer at full speed. If that arc comes down
+// through height y, where handleCollisions' sweep lands it however far the
+// tick falls, returns true with [lo, hi] the player's possible left edges
+// at the moment of crossing.
+inline bool jumpReach(const SimParams& params, const PlatformSpec& from, float y, float& lo, float& hi) {
+    lo = std::max(0.0f, from.x - PLAYER_SIZE + 1);
+    hi = std::min(WIDTH - PLAYER_SIZE, from.x + from.width - 1);
+    float feet = from.y;
+    float vy = params.jumpForce;
+    bool doubleJumped = false;
+    for (int tick = 0; tick < TICK_RATE * 10; tick++) {
+        float prevFeet = feet;
+        float prevLo = lo, prevHi = hi;
+        feet += vy + 0.5f * params.gravity;
+        vy += params.gravity;
+        lo = std::max(0.0f, lo - params.maxSpeed);
+        hi = std::min(WIDTH - PLAYER_SIZE, hi + params.maxSpeed);
+        if (!doubleJumped && vy >= 0) {
+            vy = params.doubleJumpForce;
+            doubleJumped = true;
+        }
+        if (vy > 0 && prevFeet <= y && feet > y) {
+            float t = (y - prevFeet) / (feet - prevFeet);
+            lo = prevLo + (lo - prevLo) * t;
+            hi = prevHi + (hi - prevHi) * t;
+            return true;
+        }
+        if (vy > 0 && feet > from.y) return false;
+    }
+    return false;
+}
+
+inline bool platformReachable(const SimParams& params, const PlatformSpec& from, const PlatformSpec& to) {
+    float lo, hi;
+    return jumpReach(params, from, to.y, lo, hi) && lo < to.x + to.width && hi + PLAYER_SIZE > to.x;
+}
+
+// Kinds and pickups are drawn from a stream of their own, so where the
+// platforms are does not depend on platforms.cfg.
+inline void assignKinds(const SimParams& params, std::uint64_t seed, int index, TowerChunk& chunk) {
+    Rng rng(seed ^ (static_cast<std::uint64_t>(index) + 1) * 0x9E6C63D0676A9A99ull);
+    for (PlatformSpec& spec : chunk.platforms) {
+        float climbed = groundSpec().y - spec.y;
+        float total = 0;
+        for (int k = 0; k < params.platformKindCount; k++) {
+            if (params.platformKinds[k].fromHeight <= climbed) total += params.platformKinds[k].weight;
+        }
+        float roll = rng.nextFloat() * total;
+        spec.kind = 0;
+        for (int k = 0; k < params.platformKindCount; k++) {
+            const PlatformKind& kind = params.platformKinds[k];
+            if (kind.fromHeight > climbed) continue;
+            if (roll < kind.weight) {
+                spec.kind = static_cast<std::uint8_t>(k);
+                break;
+            }
+            roll -= kind.weight;
+        }
+        spec.pickup = -1;
+        for (int k = 0; k < params.pickupKindCount; k++) {
+            const PickupKind& kind = params.pickupKinds[k];
+            if (kind.fromHeight <= climbed && rng.nextFloat() < kind.chance) {
+                spec.pickup = static_cast<std::int8_t>(k);
+                break;
+            }
+        }
+    }
+}
+
+// Fills one chunk of the tower. Each platform is placed at random among the
+// positions the jump arc from the previous one can land on. The result
+// depends only on the arguments, so a chunk is the same whichever thread
+// generates it and replays stay exact.
+inline void generateChunk(const SimParams& params, std::uint64_t seed, int index, const PlatformSpec& previous,
+                          TowerChunk& out) {
+    Rng rng(seed ^ (static_cast<std::uint64_t>(index) + 1) * 0xD6E8FEB86659FD93ull);
+    out.seed = seed;
+    out.index = index;
+    PlatformSpec prev = previous;
+    for (PlatformSpec& spec : out.platforms) {
+        float climbed = groundSpec().y - prev.y;
+        float difficulty = std::min(1.0f, climbed / DIFFICULTY_HEIGHT);
+        spec.width = std::round(PLATFORM_WIDTH * (1 - (1 - MIN_WIDTH_SCALE) * difficulty));
+        spec.y = prev.y - params.platformSpacing * (1 + (MAX_SPACING_SCALE - 1) * difficulty);
+        float lo, hi;
+        int first = 0, last = -1;
+        if (jumpReach(params, prev, spec.y, lo, hi)) {
+            first = std::max(0, static_cast<int>(std::floor(lo - spec.width)) + 1);
+            last = std::min(WIDTH - static_cast<int>(spec.width), static_cast<int>(std::ceil(hi + PLAYER_SIZE)) - 1);
+        }
+        if (first <= last) {
+            spec.x = static_cast<float>(first + rng.nextInt(last - first + 1));
+        } else {
+            // Out of reach: fall back to the base spacing straight above.
+            spec.y = prev.y - params.platformSpacing;
+            spec.x = std::min(std::max(prev.x, 0.0f), WIDTH - spec.width);
+        }
+        prev = spec;
+    }
+    if (params.hasContent()) assignKinds(params, seed, index, out);
+}
+
+// Something that produces chunks ahead of time (TowerWorker in tower.h).
+class ChunkSource {
+public:
+    virtual ~ChunkSource() = default;
+    // Copies chunk `index` of the tower for `seed` into out if it is ready;
+    // leaves out untouched otherwise.
+    virtual bool take(std::uint64_t seed, int index, TowerChunk& out) = 0;
+};
+
+// Hands out a tower's platforms bottom to top. Chunks come from the source
+// when it has them ready and are generated inline otherwise, so the caller
+// never waits and the tower is the same either way.
+class TowerFeed {
+public:
+    ChunkSource* source = nullptr;
+
+    void reset(std::uint64_t towerSeed) {
+        seed = towerSeed;
+        chunk.index = -1;
+        cursor = TOWER_CHUNK_SIZE;
+    }
+
+    PlatformSpec next(const SimParams& params) {
+        if (cursor == TOWER_CHUNK_SIZE) {
+            int index = chunk.index + 1;
+            PlatformSpec previous = index == 0 ? groundSpec() : chunk.platforms[TOWER_CHUNK_SIZE - 1];
+            if (!source || !source->take(seed, index, chunk)) generateChunk(params, seed, index, previous, chunk);
+            cursor = 0;
+        }
+        return chunk.platforms[cursor++];
+    }
+
+private:
+    std::uint64_t seed = 0;
+    TowerChunk chunk;
+    int cursor = TOWER_CHUNK_SIZE;
+};
+
+// Moving platforms, kept apart from the ring so one tight loop moves them
+// all; slot is the platform's index in Simulation::platforms.
+struct MovingPlatforms {
+    std::vector<int> slot;
+    std::vector<float> x, vx, minX, maxX;
+
+    int size() const { return static_cast<int>(slot.size()); }
+
+    void clear() {
+        for (auto* v : {&x, &vx, &minX, &maxX}) v->clear();
+        slot.clear();
+    }
+
+    void reserve(int n) {
+        for (auto* v : {&x, &vx, &minX, &maxX}) v->reserve(n);
+        slot.reserve(n);
+    }
+};
+
+// Platforms counting down to crumbling away. An entry whose platform has
+// been recycled since (its generation moved on) runs out without effect.
+struct CrumblingPlatforms {
+    std::vector<int> slot;
+    std::vector<std::uint32_t> generation;
+    std::vector<float> timeLeft;
+
+    int size() const { return static_cast<int>(slot.size()); }
+
+    void clear() {
+        slot.clear();
+        generation.clear();
+        timeLeft.clear();
+    }
+
+    void reserve(int n) {
+        slot.reserve(n);
+        generation.reserve(n);
+        timeLeft.reserve(n);
+    }
+};
+
+class Simulation {
+public:
+    SimParams params;
+    PlayerState player;
+    // Ring buffer ordered bottom to top starting at platformHead: the lowest
+    // platform is recycled to the top, so walking the ring from the head gives
+    // strictly decreasing y.
+    std::vector<PlatformState> platforms;
+    int platformHead;
+    int score;
+    bool gameOver;
+    // World y of the top edge of the screen.
+    float cameraY;
+    float scrollSpeed;
+    float highestY;
+    std::uint64_t ticks;
+    // Platforms recycled to the top since reset; with the seed this fixes
+    // which stretch of the tower the ring holds.
+    std::uint32_t recycled;
+    // Input of the previous tick, for press detection.
+    std::uint8_t lastInput;
+    // Slot of the platform landed on last tick, or -1 in the air.
+    int ground;
+    MovingPlatforms movers;
+    CrumblingPlatforms crumbles;
+    // Seconds left on each pickup kind's effect.
+    float effectTime[MAX_PICKUP_KINDS];
+    ParticleBurst bursts[MAX_BURSTS];
+    int burstCount;
+    // Supplies new platforms; point tower.source at a TowerWorker to have
+    // them generated ahead of time on another thread.
+    TowerFeed tower;
+
+    explicit Simulation(const SimParams& p = SimParams()) : params(p) {
+        reset(1);
+    }
+
+    void reset(std::uint64_t seed) {
+        tower.reset(seed);
+        player = PlayerState();
+        player.pos = {WIDTH / 2.0f, HEIGHT - 100.0f};
+        score = 0;
+        gameOver = false;
+        cameraY = 0;
+        scrollSpeed = 0;
+        highestY = HEIGHT - 100;
+        ticks = 0;
+        recycled = 0;
+        lastInput = 0;
+        burstCount = 0;
+        ground = -1;
+        for (float& t : effectTime) t = 0;
+
+        platforms.assign(params.platformCount, PlatformState());
+        platformHead = 0;
+        movers.clear();
+        crumbles.clear();
+        // Stale crumble entries can briefly outnumber the platforms.
+        movers.reserve(params.platformCount);
+        crumbles.reserve(2 * params.platformCount);
+        placePlatform(0, groundSpec());
+        platforms[0].scored = true;
+        for (int i = 1; i < params.platformCount; i++) placePlatform(i, tower.next(params));
+    }
+
+    // Always called with the same deltaTime (1 / tick rate); identical seeds and
+    // input streams then give bit-identical runs.
+    void step(std::uint8_t input, float deltaTime) {
+        burstCount = 0;
+        if (gameOver) return;
+        if ((input & INPUT_JUMP) && !(lastInput & INPUT_JUMP)) input |= INPUT_JUMP_PRESSED;
+        lastInput = input;
+        {
+            PROFILE_SCOPE(Phase::Platforms);
+            updatePlatforms(deltaTime);
+        }
+        {
+            PROFILE_SCOPE(Phase::Input);
+            handleInput(input, deltaTime);
+        }
+        {
+            PROFILE_SCOPE(Phase::WallJump);
+            checkWallJump(input);
+        }
+        const Vec2 from = player.pos;
+        const float fromVelY = player.vel.y;
+        {
+            PROFILE_SCOPE(Phase::PlayerUpdate);
+            updatePlayer(deltaTime);
+            handleWallCollision();
+        }
+        {
+            PROFILE_SCOPE(Phase::Collisions);
+            handleCollisions(from, fromVelY, deltaTime);
+            collectPickups();
+        }
+        {
+            PROFILE_SCOPE(Phase::Camera);
+            updateCamera(deltaTime, from.y);
+        }
+        ticks++;
+    }
+
+    int platformCount() const { return static_cast<int>(platforms.size()); }
+
+    // Slot of the k-th platform counting up from the bottom of the tower.
+    // A compare instead of a modulo: this sits in every collision search.
+    int slotAt(int k) const {
+        int slot = platformHead + k;
+        return slot < platformCount() ? slot : slot - platformCount();
+    }
+
+    const PlatformState& platformAt(int k) const { return platforms[slotAt(k)]; }
+
+    const PlatformState& topPlatform() const { return platformAt(platformCount() - 1); }
+
+    // Index (from the bottom) of the lowest platform whose top is at or above y.
+    int firstPlatformAbove(float y) const {
+        int lo = 0, hi = platformCount();
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (platformAt(mid).pos.y > y) lo = mid + 1;
+            else hi = mid;
+        }
+        return lo;
+    }
+
+    // Top speed with any active speed pickups.
+    float maxSpeed() const {
+        float speed = params.maxSpeed;
+        for (int k = 0; k < params.pickupKindCount; k++) {
+            if (effectTime[k] > 0) speed *= params.pickupKinds[k].speedScale;
+        }
+        return speed;
+    }
+
+    // Air jumps a landing restores on top of the double jump.
+    int extraJumpBonus() const {
+        int jumps = 0;
+        for (int k = 0; k < params.pickupKindCount; k++) {
+            if (effectTime[k] > 0) jumps += params.pickupKinds[k].extraJumps;
+        }
+        return jumps;
+    }
+
+    // The individual phases of step(); public so benchmarks can time them.
+
+    // Each set of platforms that changes over time is updated in its own
+    // loop; plain platforms cost nothing. A player standing on a moving
+    // platform is carried along.
+    void updatePlatforms(float deltaTime) {
+        int carrier = ground >= 0 && platforms[ground].mover >= 0 ? ground : -1;
+        float carrierX = carrier >= 0 ? platforms[carrier].pos.x : 0;
+        const int moving = movers.size();
+        const float scale = deltaTime * 60.0f;
+        float* x = movers.x.data();
+        float* vx = movers.vx.data();
+        const float* minX = movers.minX.data();
+        const float* maxX = movers.maxX.data();
+        // Four at a time, then the rest; both give the same bits.
+        int i = 0;
+        for (; i + 4 <= moving; i += 4) {
+            F4 v = loadF4(&vx[i]);
+            F4 next = loadF4(&x[i]) + v * scale;
+            F4 clamped = minF4(maxF4(next, loadF4(&minX[i])), loadF4(&maxX[i]));
+            storeF4(&vx[i], select(clamped != next, -v, v));
+            storeF4(&x[i], clamped);
+        }
+        for (; i < moving; i++) {
+            float next = x[i] + vx[i] * scale;
+            float clamped = std::min(std::max(next, minX[i]), maxX[i]);
+            vx[i] = clamped != next ? -vx[i] : vx[i];
+            x[i] = clamped;
+        }
+        for (i = 0; i < moving; i++) platforms[movers.slot[i]].pos.x = x[i];
+        if (carrier >= 0) player.pos.x += platforms[carrier].pos.x - carrierX;
+
+        for (int i = 0; i < crumbles.size();) {
+            crumbles.timeLeft[i] -= deltaTime;
+            if (crumbles.timeLeft[i] > 0) {
+                i++;
+                continue;
+            }
+            PlatformState& plat = platforms[crumbles.slot[i]];
+            if (plat.generation == crumbles.generation[i]) plat.active = false;
+            int last = crumbles.size() - 1;
+            crumbles.slot[i] = crumbles.slot[last];
+            crumbles.generation[i] = crumbles.generation[last];
+            crumbles.timeLeft[i] = crumbles.timeLeft[last];
+            crumbles.slot.pop_back();
+            crumbles.generation.pop_back();
+            crumbles.timeLeft.pop_back();
+        }
+
+        for (int k = 0; k < params.pickupKindCount; k++) {
+            if (effectTime[k] > 0) effectTime[k] = std::max(0.0f, effectTime[k] - deltaTime);
+        }
+    }
+
+    void handleInput(std::uint8_t input, float deltaTime) {
+        float speed = maxSpeed();
+        float target = 0;
+        if (input & INPUT_LEFT) target = -speed;
+        if (input & INPUT_RIGHT) target = speed;
+        // On ice steering only eases the speed towards the target, by the
+        // kind's friction per 60 Hz tick whatever the tick rate.
+        float friction = ground >= 0 ? params.platformKinds[platforms[ground].kind].friction : 1.0f;
+        if (friction < 1) player.vel.x += (target - player.vel.x) * (1 - std::pow(1 - friction, deltaTime * 60.0f));
+        else player.vel.x = target;
+        if ((input & INPUT_JUMP_PRESSED) && (player.canJump || player.canDoubleJump || player.extraJumps > 0)) {
+            if (player.canJump) {
+                player.vel.y = params.jumpForce;
+                player.canJump = false;
+                player.canDoubleJump = true;
+            } else if (player.canDoubleJump) {
+                player.vel.y = params.doubleJumpForce;
+                player.canDoubleJump = false;
+            } else {
+                player.vel.y = params.doubleJumpForce;
+                player.extraJumps--;
+            }
+        }
+    }
+
+    void checkWallJump(std::uint8_t input) {
+        AABB bounds = player.bounds();
+        bool jump = (input & INPUT_JUMP_PRESSED) != 0;
+        float speed = maxSpeed();
+        if (!player.canJump && bounds.left <= 0 && jump) {
+            player.vel.y = params.wallJumpForce;
+            player.vel.x = speed;
+            player.isWallJumping = true;
+            player.lastWall = {0, bounds.top};
+        } else if (!player.canJump && bounds.left >= WIDTH - bounds.width && jump) {
+            player.vel.y = params.wallJumpForce;
+            player.vel.x = -speed;
+            player.isWallJumping = true;
+            player.lastWall = {static_cast<float>(WIDTH), bounds.top};
+        } else if (player.isWallJumping && std::abs(bounds.top - player.lastWall.y) > 50) {
+            player.isWallJumping = false;
+            if (input & INPUT_LEFT) player.vel.x = -speed;
+            else if (input & INPUT_RIGHT) player.vel.x = speed;
+            else player.vel.x = 0;
+        }
+    }
+
+    // Gravity is constant over a step, so the fall is integrated exactly:
+    // an arc passes through the same heights at any tick rate.
+    void updatePlayer(float deltaTime) {
+        const float steps = deltaTime * 60.0f;
+        const float pull = params.gravity * steps;
+        player.pos.x += player.vel.x * steps;
+        player.pos.y += (player.vel.y + 0.5f * pull) * steps;
+        player.vel.y += pull;
+
+        if (player.vel.x > 0) player.facingRight = true;
+        else if (player.vel.x < 0) player.facingRight = false;
+    }
+
+    void handleWallCollision() {
+        if (player.pos.x <= 0) {
+            if (player.vel.x < 0) addBurst(0, player.pos.y + PLAYER_SIZE / 2, 3.0f);
+            player.pos.x = 0;
+            player.vel.x = -player.vel.x * params.wallBounceDamping;
+        } else if (player.pos.x >= WIDTH - PLAYER_SIZE) {
+            if (player.vel.x > 0) addBurst(WIDTH, player.pos.y + PLAYER_SIZE / 2, 3.0f);
+            player.pos.x = WIDTH - PLAYER_SIZE;
+            player.vel.x = -player.vel.x * params.wallBounceDamping;
+        }
+    }
+
+    // Swept along the player's path this tick: the feet follow
+    // fromFeet + a*s + b*s*s over the share s of the step. A platform is
+    // landed on if the player was over it at any moment the falling feet
+    // were between its top and LANDING_BAND below it, so however far a step
+    // falls the player lands on the first top crossed. The moments are
+    // solved exactly, which makes landings the same at any tick rate.
+    // Binary search finds the candidates in the ring.
+    void handleCollisions(Vec2 from, float fromVelY, float deltaTime) {
+        ground = -1;
+        if (player.vel.y <= 0) return;
+
+        const float steps = deltaTime * 60.0f;
+        const float a = fromVelY * steps;
+        const float b = 0.5f * params.gravity * steps * steps;
+        float feet = player.pos.y + PLAYER_SIZE;
+        float fromFeet = from.y + PLAYER_SIZE;
+        float apex = a < 0 ? std::min(-a / (2 * b), 1.0f) : 0.0f;
+        float fallFeet = fromFeet + (a + b * apex) * apex;
+        float bandTop = fallFeet - LANDING_BAND;
+        int hit = -1;
+        float hitAt = 0;
+        for (int k = firstPlatformAbove(feet); k < platformCount(); k++) {
+            int slot = slotAt(k);
+            const PlatformState& plat = platforms[slot];
+            float top = plat.pos.y;
+            if (top < bandTop) break;
+            if (!plat.active || top >= feet) continue;
+            float enter = top <= fallFeet ? apex : fallShare(a, b, top - fromFeet);
+            float leave = top + LANDING_BAND >= feet ? 1.0f : fallShare(a, b, top + LANDING_BAND - fromFeet);
+            float enterX = from.x + (player.pos.x - from.x) * enter;
+            float leaveX = from.x + (player.pos.x - from.x) * leave;
+            float left = std::min(enterX, leaveX), right = std::max(enterX, leaveX);
+            // Walking up the ring, the last hit is the highest: the first crossed.
+            if (std::max(left, plat.pos.x) < std::min(right + PLAYER_SIZE, plat.pos.x + plat.width)) {
+                hit = slot;
+                hitAt = enter;
+            }
+        }
+        if (hit < 0) return;
+        land(hit);
+        if (ground == hit) walkOff(from.x, hitAt, steps);
+    }
+
+    // A player who lands and walks off the edge within the same step falls
+    // from the edge for the rest of it, as they would over shorter steps.
+    void walkOff(float fromX, float landedAt, float steps) {
+        const PlatformState& plat = platforms[ground];
+        float right = plat.pos.x + plat.width;
+        float dx = player.pos.x - fromX;
+        float off;
+        if (player.pos.x >= right) off = (right - fromX) / dx;
+        else if (player.pos.x + PLAYER_SIZE <= plat.pos.x) off = (plat.pos.x - PLAYER_SIZE - fromX) / dx;
+        else return;
+        float rest = (1 - std::min(std::max(off, landedAt), 1.0f)) * steps;
+        player.pos.y += 0.5f * params.gravity * rest * rest;
+        player.vel.y = params.gravity * rest;
+        ground = -1;
+    }
+
+    // Stands the player on a platform: resets jumps, scores it the first
+    // time, and applies its kind.
+    void land(int slot) {
+        PlatformState& plat = platforms[slot];
+        player.vel.y = 0;
+        player.pos.y = plat.pos.y - PLAYER_SIZE;
+        player.canJump = true;
+        player.canDoubleJump = true;
+        player.extraJumps = extraJumpBonus();
+        ground = slot;
+        addBurst(player.pos.x + PLAYER_SIZE / 2, plat.pos.y, 3.0f);
+
+        if (!plat.scored) {
+            score += 10;
+            plat.scored = true;
+        }
+
+        const PlatformKind& kind = params.platformKinds[plat.kind];
+        if (kind.crumbleTime > 0 && !plat.crumbling) {
+            plat.crumbling = true;
+            crumbles.slot.push_back(slot);
+            crumbles.generation.push_back(plat.generation);
+            crumbles.timeLeft.push_back(kind.crumbleTime);
+        }
+        if (kind.bounce > 0) {
+            player.vel.y = params.jumpForce * kind.bounce;
+            player.canJump = false;
+            ground = -1;
+        }
+    }
+
+    // A pickup hovers over its platform, so only platforms just below the
+    // player's box can hold one it touches.
+    void collectPickups() {
+        if (params.pickupKindCount == 0) return;
+        AABB bounds = player.bounds();
+        for (int k = firstPlatformAbove(bounds.bottom() + PICKUP_HOVER + PICKUP_SIZE); k < platformCount(); k++) {
+            PlatformState& plat = platforms[slotAt(k)];
+            if (plat.pos.y <= bounds.top + PICKUP_HOVER) break;
+            if (plat.pickup < 0 || !plat.active || !bounds.intersects(plat.pickupBounds())) continue;
+            const PickupKind& kind = params.pickupKinds[plat.pickup];
+            effectTime[plat.pickup] = kind.duration;
+            player.extraJumps += kind.extraJumps;
+            AABB pickup = plat.pickupBounds();
+            addBurst(pickup.left + PICKUP_SIZE / 2, pickup.top + PICKUP_SIZE / 2, 4.0f);
+            plat.pickup = -1;
+        }
+    }
+
+    // Entities stay in world coordinates; only the camera moves. The scroll
+    // speed, in pixels per 60 Hz tick like every other speed, eases towards
+    // keeping the player in the upper half of the screen. It eases in
+    // CAMERA_STEP slices whatever the tick rate, following the player along
+    // the step from fromY, and a player who leaves the screen during any
+    // slice is out: the camera and the moment of death do not depend on
+    // the rate.
+    void updateCamera(float deltaTime, float fromY) {
+        const int slices = cameraSlices(deltaTime);
+        const float slice = deltaTime / slices;
+        for (int i = 1; i <= slices; i++) {
+            float playerTop = i == slices ? player.pos.y
+                                          : fromY + (player.pos.y - fromY) * static_cast<float>(i) / static_cast<float>(slices);
+            float targetScroll = (playerTop - cameraY) - HEIGHT / 2;
+            if (targetScroll > 0) targetScroll = 0;
+            scrollSpeed += (targetScroll - scrollSpeed) * 5.0f * slice;
+            cameraY += scrollSpeed * slice * 60.0f;
+            if (playerTop - cameraY > HEIGHT) gameOver = true;
+        }
+
+        // Kept until even a player standing on it would be off the screen,
+        // so no rate recycles a platform the player can still land on.
+        while (platforms[platformHead].pos.y - cameraY > HEIGHT + PLAYER_SIZE) recyclePlatform();
+
+        highestY = std::min(highestY, player.pos.y);
+    }
+
+    // Moves the bottom platform to the top of the tower in O(1).
+    void recyclePlatform() {
+        if (ground == platformHead) ground = -1;
+        placePlatform(platformHead, tower.next(params));
+        platforms[platformHead].generation++;
+        platformHead = (platformHead + 1) % platformCount();
+        recycled++;
+    }
+
+
+private:
+    // Fills a slot from the tower and files it with its kind's set.
+    void placePlatform(int slot, const PlatformSpec& spec) {
+        PlatformState& plat = platforms[slot];
+        if (plat.mover >= 0) removeMover(plat.mover);
+        plat.pos = {spec.x, spec.y};
+        plat.width = spec.width;
+        plat.kind = spec.kind;
+        plat.pickup = spec.pickup;
+        plat.active = true;
+        plat.scored = false;
+        plat.crumbling = false;
+        const PlatformKind& kind = params.platformKinds[spec.kind];
+        if (kind.moveSpeed > 0 && kind.moveRange > 0) {
+            plat.mover = movers.size();
+            movers.slot.push_back(slot);
+            movers.x.push_back(spec.x);
+            // Alternate directions so neighbours do not move in step.
+            movers.vx.push_back(recycled & 1 ? -kind.moveSpeed : kind.moveSpeed);
+            movers.minX.push_back(std::max(0.0f, spec.x - kind.moveRange));
+            movers.maxX.push_back(std::min(WIDTH - spec.width, spec.x + kind.moveRange));
+        }
+    }
+
+    // Swaps the last mover into index i.
+    void removeMover(int i) {
+        int last = movers.size() - 1;
+        platforms[movers.slot[i]].mover = -1;
+        if (i != last) {
+            movers.slot[i] = movers.slot[last];
+            movers.x[i] = movers.x[last];
+            movers.vx[i] = movers.vx[last];
+            movers.minX[i] = movers.minX[last];
+            movers.maxX[i] = movers.maxX[last];
+            platforms[movers.slot[i]].mover = i;
+        }
+        movers.slot.pop_back();
+        for (auto* v : {&movers.x, &movers.vx, &movers.minX, &movers.maxX}) v->pop_back();
+    }
+
+    void addBurst(float x, float y, float size) {
+        if (burstCount < MAX_BURSTS) bursts[burstCount++] = {x, y, size};
+    }
+};
+
+// Cheap scripted player: steer under the nearest platform above and jump,
+// using the double jump once the first jump starts falling.
+inline std::uint8_t scriptedInput(const Simulation& sim, bool& jumpHeld) {
+    const PlayerState& p = sim.player;
+    float feet = p.pos.y + PLAYER_SIZE;
+    const PlatformState* target = nullptr;
+    for (int k = sim.firstPlatformAbove(feet - 1); k < sim.platformCount(); k++) {
+        if (sim.platformAt(k).pos.y < feet - 1) {
+            target = &sim.platformAt(k);
+            break;
+        }
+    }
+
+    std::uint8_t input = 0;
+    if (target) {
+        float center = p.pos.x + PLAYER_SIZE / 2;
+        float targetCenter = target->pos.x + target->width / 2;
+        if (center < targetCenter - 10) input |= INPUT_RIGHT;
+        else if (center > targetCenter + 10) input |= INPUT_LEFT;
+    }
+
+    bool wantJump = p.canJump || (p.canDoubleJump && p.vel.y > 0);
+    if (wantJump && !jumpHeld) input |= INPUT_JUMP;
+    jumpHeld = (input & INPUT_JUMP) != 0;
+    return input;
+}
@@ -0,0 +1,389 @@
+#include "sim.h"
+#include "particles.h"
+#include "alloc_tracker.h"
+#include "replay.h"
+#include "vec_env.h"
+#include "content.h"
+#include "bot.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct BatchConfig {
+    int games = 1000;
+    int threads = 0;
+    int maxTicks = TICK_RATE * 60 * 5;
+    int tickRate = TICK_RATE;
+    std::uint64_t seed = 1;
+    bool csv = false;
+    bool allocCheck = false;
+    bool rateCheck = false;
+    std::vector<std::string> replays;
+    std::string recordDir;
+    int vecEnvs = 0;
+    bool botMatch = false;
+    BotConfig bot;
+    SimParams params;
+};
+
+struct GameResult {
+    int score;
+    std::uint64_t ticks;
+    bool died;
+};
+
+static GameResult playGame(const BatchConfig& config, std::uint64_t seed) {
+    Simulation sim(config.params);
+    sim.reset(seed);
+    bool jumpHeld = false;
+    const float deltaTime = 1.0f / config.tickRate;
+    InputRecorder recorder;
+    if (!config.recordDir.empty()) recorder.begin(seed, config.tickRate, config.params);
+    while (!sim.gameOver && sim.ticks < static_cast<std::uint64_t>(config.maxTicks)) {
+        std::uint8_t input = scriptedInput(sim, jumpHeld);
+        if (recorder.active()) recorder.record(input);
+        sim.step(input, deltaTime);
+    }
+    if (recorder.active()) {
+        std::string path = config.recordDir + "/game-" + std::to_string(seed) + ".icyrec";
+        if (!recorder.save(path, sim)) std::cerr << "Failed to write " << path << "." << std::endl;
+    }
+    return {sim.score, sim.ticks, sim.gameOver};
+}
+
+// Steps one game (restarting it on death) and fails if any tick after the
+// warm-up touches the heap. Resets are not counted. With --bot-match the
+// lookahead bot plays, and its searches count too.
+static int runAllocCheck(const BatchConfig& config) {
+    if (!AllocTracker::enabled()) {
+        std::cerr << "--alloc-check needs a build with -DICY_TRACK_ALLOCS (make alloc-check)." << std::endl;
+        return 1;
+    }
+    std::optional<LookaheadBot> bot;
+    if (config.botMatch) bot.emplace(config.params, config.bot);
+    Simulation sim(config.params);
+    ParticlePool particles(MAX_PARTICLES, config.seed);
+    sim.reset(config.seed);
+    bool jumpHeld = false;
+    const float deltaTime = 1.0f / config.tickRate;
+    const int warmupTicks = config.tickRate * 2;
+    int allocatingTicks = 0;
+    for (int tick = 0; tick < warmupTicks + config.maxTicks; tick++) {
+        if (sim.gameOver) sim.reset(config.seed + tick);
+        std::uint64_t before = AllocTracker::count();
+        sim.step(bot ? bot->input(sim, deltaTime) : scriptedInput(sim, jumpHeld), deltaTime);
+        for (int i = 0; i < sim.burstCount; i++) {
+            particles.emit(sim.bursts[i].x, sim.bursts[i].y, sim.bursts[i].size);
+        }
+        particles.update(deltaTime);
+        if (tick >= warmupTicks && AllocTracker::count() != before) allocatingTicks++;
+    }
+    std::cout << allocatingTicks << " of " << config.maxTicks << " steady-state ticks allocated" << std::endl;
+    return allocatingTicks == 0 ? 0 : 1;
+}
+
+// Tick rates --rate-check compares, each a whole multiple of the first.
+const int CHECK_RATES[] = {15, 30, 60, 120};
+
+// Plays each seed's input script at every CHECK_RATES rate and fails if the
+// scores differ. The script is the scripted player's choices at 15 Hz, each
+// held for a fifteenth of a second whatever the rate.
+static int runRateCheck(const BatchConfig& config) {
+    const int slowest = CHECK_RATES[0];
+    const std::uint64_t maxSlots = static_cast<std::uint64_t>(config.maxTicks) * slowest / TICK_RATE;
+    Simulation sim(config.params);
+    std::vector<std::uint8_t> script;
+    int mismatches = 0;
+    for (int i = 0; i < config.games; i++) {
+        std::uint64_t seed = config.seed + i;
+        sim.reset(seed);
+        bool jumpHeld = false;
+        script.clear();
+        while (!sim.gameOver && script.size() < maxSlots) {
+            script.push_back(scriptedInput(sim, jumpHeld));
+            sim.step(script.back(), 1.0f / slowest);
+        }
+
+        int scores[std::size(CHECK_RATES)];
+        for (std::size_t r = 0; r < std::size(CHECK_RATES); r++) {
+            const int repeat = CHECK_RATES[r] / slowest;
+            sim.reset(seed);
+            for (std::size_t slot = 0; slot < script.size() && !sim.gameOver; slot++) {
+                for (int t = 0; t < repeat; t++) sim.step(script[slot], 1.0f / CHECK_RATES[r]);
+            }
+            scores[r] = sim.score;
+        }
+        if (std::equal(scores + 1, std::end(scores), scores)) continue;
+        if (++mismatches <= 10) {
+            std::cerr << "seed " << seed << ":";
+            for (std::size_t r = 0; r < std::size(CHECK_RATES); r++) {
+                std::cerr << " " << scores[r] << " at " << CHECK_RATES[r] << " Hz";
+            }
+            std::cerr << std::endl;
+        }
+    }
+    std::cout << config.games - mismatches << " of " << config.games << " scripts scored the same at 15-120 Hz"
+              << std::endl;
+    return mismatches == 0 ? 0 : 1;
+}
+
+// Climbed height in pixels, from the player's start to the highest point reached.
+static float heightClimbed(const Simulation& sim) {
+    return HEIGHT - 100 - sim.highestY;
+}
+
+// Scripted player against LookaheadBot on the same towers. Games run one at a
+// time; the bot's search spreads over the worker threads.
+static int runBotMatch(const BatchConfig& config) {
+    LookaheadBot bot(config.params, config.bot);
+    const float deltaTime = 1.0f / config.tickRate;
+    const std::uint64_t maxTicks = config.maxTicks;
+    double score[2] = {}, height[2] = {}, best[2] = {};
+    int deaths[2] = {};
+    double searchSeconds = 0;
+    for (int i = 0; i < config.games; i++) {
+        for (int player = 0; player < 2; player++) {
+            Simulation sim(config.params);
+            sim.reset(config.seed + i);
+            bool jumpHeld = false;
+            auto start = std::chrono::steady_clock::now();
+            while (!sim.gameOver && sim.ticks < maxTicks) {
+                std::uint8_t input = player == 0 ? scriptedInput(sim, jumpHeld) : bot.input(sim, deltaTime);
+                sim.step(input, deltaTime);
+            }
+            if (player == 1) {
+                searchSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            }
+            score[player] += sim.score;
+            height[player] += heightClimbed(sim);
+            best[player] = std::max<double>(best[player], heightClimbed(sim));
+            deaths[player] += sim.gameOver;
+        }
+    }
+
+    double steps = static_cast<double>(bot.simulatedTicks());
+    std::cout << "games:        " << config.games << ", up to " << config.maxTicks << " ticks each\n"
+              << "              scripted  lookahead\n"
+              << "score mean:   " << score[0] / config.games << "  " << score[1] / config.games << "\n"
+              << "height mean:  " << height[0] / config.games << "  " << height[1] / config.games << "\n"
+              << "height max:   " << best[0] << "  " << best[1] << "\n"
+              << "died:         " << deaths[0] << "  " << deaths[1] << "\n"
+              << "search:       " << bot.threadCount() << " threads, " << steps << " steps in " << searchSeconds
+              << " s\n"
+              << "steps/second/core: " << steps / (searchSeconds * bot.threadCount()) << std::endl;
+    return 0;
+}
+
+// Regression mode: replays every recording across the worker threads and
+// fails if any of them no longer reproduces its recorded outcome.
+static int runReplays(const BatchConfig& config) {
+    int count = static_cast<int>(config.replays.size());
+    std::vector<std::string> messages(count);
+    std::vector<char> passed(count, 0);
+    std::atomic<int> next(0);
+    std::atomic<std::uint64_t> totalTicks(0);
+    auto worker = [&]() {
+        for (int i = next++; i < count; i = next++) {
+            std::uint64_t ticks;
+            passed[i] = verifyReplay(config.replays[i], messages[i], ticks);
+            totalTicks += ticks;
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> pool;
+    for (int t = 0; t < config.threads; t++) pool.emplace_back(worker);
+    for (auto& t : pool) t.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    int failures = 0;
+    for (int i = 0; i < count; i++) {
+        if (passed[i]) continue;
+        failures++;
+        std::cout << "FAIL " << messages[i] << "\n";
+    }
+    std::cout << count - failures << " of " << count << " replays reproduced, " << totalTicks << " ticks in "
+              << seconds << " s" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
+
+// Training throughput: every thread steps its own VecEnv of config.vecEnvs
+// games with random actions, config.maxTicks times.
+static int runVecEnvs(const BatchConfig& config) {
+    std::atomic<std::uint64_t> episodes(0), points(0);
+    auto worker = [&](int thread) {
+        VecEnv env(config.vecEnvs, config.params, config.tickRate);
+        env.reset(config.seed + (std::uint64_t(thread) << 32));
+        Rng rng(config.seed + thread);
+        std::vector<std::uint8_t> actions(config.vecEnvs);
+        std::uint64_t done = 0;
+        double reward = 0;
+        for (int tick = 0; tick < config.maxTicks; tick++) {
+            for (auto& a : actions) a = static_cast<std::uint8_t>(rng.next() & 7);
+            env.step(actions.data());
+            for (int e = 0; e < config.vecEnvs; e++) {
+                done += env.dones()[e];
+                reward += env.rewards()[e];
+            }
+        }
+        episodes += done;
+        points += static_cast<std::uint64_t>(reward);
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> pool;
+    for (int t = 0; t < config.threads; t++) pool.emplace_back(worker, t);
+    for (auto& t : pool) t.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double steps = double(config.vecEnvs) * config.maxTicks * config.threads;
+    std::cout << "games:        " << config.vecEnvs << " x " << config.threads << " threads\n"
+              << "episodes:     " << episodes << " finished, " << points << " points\n"
+              << "steps:        " << steps << "\n"
+              << "wall time:    " << seconds << " s\n"
+              << "steps/second: " << steps / seconds << std::endl;
+    return 0;
+}
+
+static bool parseArg(const char* arg, const char* name, std::string& value) {
+    size_t len = std::strlen(name);
+    if (std::strncmp(arg, name, len) != 0 || arg[len] != '=') return false;
+    value = arg + len + 1;
+    return true;
+}
+
+// A directory argument expands to every .icyrec file inside it.
+static void addReplays(BatchConfig& config, const std::string& path) {
+    std::error_code ec;
+    if (std::filesystem::is_directory(path, ec)) {
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(path, ec)) {
+            if (entry.path().extension() == ".icyrec") config.replays.push_back(entry.path().string());
+        }
+        std::sort(config.replays.begin(), config.replays.end());
+    } else {
+        config.replays.push_back(path);
+    }
+}
+
+static BatchConfig parseArgs(int argc, char** argv) {
+    BatchConfig config;
+    for (int i = 1; i < argc; i++) {
+        std::string v;
+        if (parseArg(argv[i], "--games", v)) config.games = std::atoi(v.c_str());
+        else if (parseArg(argv[i], "--threads", v)) config.threads = std::atoi(v.c_str());
+        else if (parseArg(argv[i], "--ticks", v)) config.maxTicks = std::atoi(v.c_str());
+        else if (parseArg(argv[i], "--tick-rate", v)) config.tickRate = std::atoi(v.c_str());
+        else if (parseArg(argv[i], "--seed", v)) config.seed = std::strtoull(v.c_str(), nullptr, 10);
+        else if (parseArg(argv[i], "--gravity", v)) config.params.gravity = std::strtof(v.c_str(), nullptr);
+        else if (parseArg(argv[i], "--jump-force", v)) config.params.jumpForce = std::strtof(v.c_str(), nullptr);
+        else if (parseArg(argv[i], "--double-jump-force", v)) config.params.doubleJumpForce = std::strtof(v.c_str(), nullptr);
+        else if (parseArg(argv[i], "--max-speed", v)) config.params.maxSpeed = std::strtof(v.c_str(), nullptr);
+        else if (parseArg(argv[i], "--spacing", v)) config.params.platformSpacing = std::strtof(v.c_str(), nullptr);
+        else if (parseArg(argv[i], "--platforms", v)) config.params.platformCount = std::atoi(v.c_str());
+        else if (parseArg(argv[i], "--content", v)) {
+            std::string error;
+            if (!loadContent(v, config.params, error)) {
+                std::cerr << error << std::endl;
+                exit(1);
+            }
+        }
+        else if (std::strcmp(argv[i], "--csv") == 0) config.csv = true;
+        else if (std::strcmp(argv[i], "--alloc-check") == 0) config.allocCheck = true;
+        else if (std::strcmp(argv[i], "--rate-check") == 0) config.rateCheck = true;
+        else if (parseArg(argv[i], "--replay", v)) addReplays(config, v);
+        else if (parseArg(argv[i], "--record-dir", v)) config.recordDir = v;
+        else if (parseArg(argv[i], "--vec-envs", v)) config.vecEnvs = std::atoi(v.c_str());
+        else if (std::strcmp(argv[i], "--bot-match") == 0) config.botMatch = true;
+        else if (parseArg(argv[i], "--bot-depth", v)) config.bot.depth = std::atoi(v.c_str());
+        else if (parseArg(argv[i], "--bot-beam", v)) config.bot.beamWidth = std::atoi(v.c_str());
+        else if (parseArg(argv[i], "--bot-segment", v)) config.bot.segmentTicks = std::atoi(v.c_str());
+        else {
+            std::cerr << "Unknown argument " << argv[i] << "." << std::endl;
+            std::cerr << "Usage: icy_tower_sim [--games=N] [--threads=N] [--ticks=N] [--tick-rate=N] [--seed=N]\n"
+                         "       [--gravity=F] [--jump-force=F] [--double-jump-force=F] [--max-speed=F]\n"
+                         "       [--spacing=F] [--platforms=N] [--content=FILE] [--csv] [--alloc-check [--bot-match]]\n"
+                         "       [--record-dir=DIR] [--vec-envs=N] [--rate-check]\n"
+                         "       icy_tower_sim --bot-match [--games=N] [--ticks=N] [--threads=N]\n"
+                         "       [--bot-depth=N] [--bot-beam=N] [--bot-segment=N]\n"
+                         "       icy_tower_sim --replay=FILE_OR_DIR... [--threads=N]" << std::endl;
+            exit(1);
+        }
+    }
+    if (config.threads <= 0) config.threads = std::max(1u, std::thread::hardware_concurrency());
+    config.bot.threads = config.threads;
+    if (!config.recordDir.empty()) {
+        std::error_code ec;
+        std::filesystem::create_directories(config.recordDir, ec);
+    }
+    if (config.games <= 0 || config.tickRate <= 0 || config.params.platformCount < 2 ||
+        config.params.platformCount > MAX_PLATFORM_COUNT) {
+        std::cerr << "Need at least one game, a positive tick rate and 2 to " << MAX_PLATFORM_COUNT << " platforms."
+                  << std::endl;
+        exit(1);
+    }
+    return config;
+}
+
+int main(int argc, char** argv) {
+    BatchConfig config = parseArgs(argc, argv);
+    if (config.allocCheck) return runAllocCheck(config);
+    if (config.rateCheck) return runRateCheck(config);
+    if (!config.replays.empty()) return runReplays(config);
+    if (config.vecEnvs > 0) return runVecEnvs(config);
+    if (config.botMatch) return runBotMatch(config);
+
+    std::vector<GameResult> results(config.games);
+    std::atomic<int> nextGame(0);
+    auto worker = [&]() {
+        for (int i = nextGame++; i < config.games; i = nextGame++) {
+            results[i] = playGame(config, config.seed + i);
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> pool;
+    for (int t = 0; t < config.threads; t++) pool.emplace_back(worker);
+    for (auto& t : pool) t.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (config.csv) {
+        std::cout << "game,seed,score,ticks,died\n";
+        for (int i = 0; i < config.games; i++) {
+            std::cout << i << ',' << config.seed + i << ',' << results[i].score << ','
+                      << results[i].ticks << ',' << results[i].died << '\n';
+        }
+        return 0;
+    }
+
+    std::vector<int> scores;
+    std::uint64_t totalTicks = 0;
+    int deaths = 0;
+    for (const auto& r : results) {
+        scores.push_back(r.score);
+        totalTicks += r.ticks;
+        deaths += r.died;
+    }
+    std::sort(scores.begin(), scores.end());
+    double mean = 0;
+    for (int s : scores) mean += s;
+    mean /= scores.size();
+
+    std::cout << "games:        " << config.games << " on " << config.threads << " threads\n"
+              << "score mean:   " << mean << "\n"
+              << "score p50:    " << scores[scores.size() / 2] << "\n"
+              << "score max:    " << scores.back() << "\n"
+              << "died:         " << deaths << " (" << config.games - deaths << " hit the tick limit)\n"
+              << "ticks:        " << totalTicks << "\n"
+              << "wall time:    " << seconds << " s\n"
+              << "ticks/second: " << static_cast<double>(totalTicks) / seconds << std::endl;
+    return 0;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Four-lane float and int vectors (GCC/Clang vector extensions), lowered to
+// SSE on x86-64 and NEON on ARM. Comparisons give all-ones/zero lane masks.
+typedef float F4 __attribute__((vector_size(16)));
+typedef std::int32_t I4 __attribute__((vector_size(16)));
+
+inline F4 loadF4(const float* p) {
+    F4 v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+inline I4 loadI4(const std::int32_t* p) {
+    I4 v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+inline void storeF4(float* p, F4 v) { std::memcpy(p, &v, sizeof(v)); }
+inline void storeI4(std::int32_t* p, I4 v) { std::memcpy(p, &v, sizeof(v)); }
+inline F4 splat(float s) { return F4{s, s, s, s}; }
+inline I4 splat(std::int32_t s) { return I4{s, s, s, s}; }
+inline F4 select(I4 mask, F4 a, F4 b) { return (F4)(((I4)a & mask) | ((I4)b & ~mask)); }
+inline I4 select(I4 mask, I4 a, I4 b) { return (a & mask) | (b & ~mask); }
+inline bool anyLane(I4 mask) { return (mask[0] | mask[1] | mask[2] | mask[3]) != 0; }
+inline F4 absF4(F4 v) { return (F4)((I4)v & 0x7FFFFFFF); }
+// Same operand order as std::max / std::min.
+inline F4 maxF4(F4 a, F4 b) { return select(a < b, b, a); }
+inline F4 minF4(F4 a, F4 b) { return select(b < a, b, a); }
+// Lane by lane; sqrt is correctly rounded, so each lane matches std::sqrt.
+inline F4 sqrtF4(F4 v) { return F4{std::sqrt(v[0]), std::sqrt(v[1]), std::sqrt(v[2]), std::sqrt(v[3])}; }
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "sim.h"
+#include "particles.h"
+#include "net.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+// Another racer as the renderer needs them.
+struct RacerView {
+    Vec2 pos;
+    bool facingRight = true;
+    bool gameOver = false;
+    int score = 0;
+};
+
+// Everything the renderer needs to draw one tick. The simulation thread fills
+// one and publishes it; from then on it is only read.
+struct FrameSnapshot {
+    PlayerState player, prevPlayer;
+    float cameraY = 0, prevCameraY = 0;
+    std::vector<PlatformState> platforms;
+    ParticlePool particles;
+    int score = 0;
+    int highScore = 0;
+    int level = 0;
+    bool gameOver = false;
+    float scorePulseTimer = 0;
+    float backgroundOffset = 0;
+    std::uint32_t run = 0;  // bumped on every reset
+    std::uint64_t tick = 0;
+    // When the tick was due; the renderer interpolates from here.
+    std::chrono::steady_clock::time_point tickTime;
+    // Latest key press the simulation has taken in, for --latency.
+    std::chrono::steady_clock::time_point pressTime;
+    // Share of each pickup kind's effect still to run.
+    float effectLeft[MAX_PICKUP_KINDS] = {};
+    // Race mode: everyone in the race, including the one followed on screen.
+    int racerCount = 0;
+    int localRacer = -1;
+    RacerView racers[MAX_RACERS];
+};
+
+// Lock-free single-producer/single-consumer triple buffer. The writer fills
+// back() and publishes it; the reader picks up the newest published slot.
+// Neither side ever waits, and a slot is never written while it is read.
+template <typename T>
+class TripleBuffer {
+public:
+    explicit TripleBuffer(const T& initial = T()) : slots{initial, initial, initial} {}
+
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    // Writer.
+    T& back() { return slots[backIndex]; }
+
+    void publish() {
+        backIndex = middle.exchange(backIndex | FRESH, std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    // Reader. Swaps in the newest slot if one was published since the last
+    // call; returns whether it did.
+    bool acquire() {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH)) return false;
+        frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & INDEX_MASK;
+        return true;
+    }
+
+    const T& front() const { return slots[frontIndex]; }
+
+private:
+    static const std::uint8_t FRESH = 4;
+    static const std::uint8_t INDEX_MASK = 3;
+
+    T slots[3];
+    std::uint8_t backIndex = 0;
+    std::atomic<std::uint8_t> middle{1};
+    std::uint8_t frontIndex = 2;
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "sim.h"
+#include "profiler.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+// Chunks the worker keeps ready ahead of the game.
+const int TOWER_LOOKAHEAD = 8;
+
+// Generates the tower ahead of the camera on its own thread. Chunks are
+// handed over through a single-producer/single-consumer ring, so neither
+// side takes a lock or waits for the other: a chunk that is not ready yet is
+// generated inline by the TowerFeed asking for it, with the same result.
+class TowerWorker : public ChunkSource {
+public:
+    explicit TowerWorker(const SimParams& params) : params(params), worker([this] { run(); }) {}
+
+    ~TowerWorker() override {
+        quit.store(true, std::memory_order_relaxed);
+        worker.join();
+    }
+
+    TowerWorker(const TowerWorker&) = delete;
+    TowerWorker& operator=(const TowerWorker&) = delete;
+
+    // Game thread: start producing the tower for seed from its first chunk.
+    void restart(std::uint64_t seed) {
+        requestedSeed.store(seed, std::memory_order_relaxed);
+        restarts.fetch_add(1, std::memory_order_release);
+    }
+
+    // Game thread. Chunks of an older tower or ones the game already
+    // generated itself are dropped on the way.
+    bool take(std::uint64_t seed, int index, TowerChunk& out) override {
+        std::uint64_t tail = readPos.load(std::memory_order_relaxed);
+        while (tail != writePos.load(std::memory_order_acquire)) {
+            const TowerChunk& chunk = ring[tail % TOWER_LOOKAHEAD];
+            if (chunk.seed == seed && chunk.index > index) return false;
+            bool match = chunk.seed == seed && chunk.index == index;
+            if (match) out = chunk;
+            readPos.store(++tail, std::memory_order_release);
+            if (match) return true;
+        }
+        return false;
+    }
+
+private:
+    const SimParams params;
+    TowerChunk ring[TOWER_LOOKAHEAD];
+    std::atomic<std::uint64_t> writePos{0};
+    std::atomic<std::uint64_t> readPos{0};
+    std::atomic<std::uint64_t> requestedSeed{0};
+    std::atomic<std::uint32_t> restarts{0};
+    std::atomic<bool> quit{false};
+    std::thread worker;
+
+    void run() {
+        std::uint32_t seenRestarts = 0;
+        std::uint64_t seed = 0;
+        int index = 0;
+        PlatformSpec previous = groundSpec();
+        while (!quit.load(std::memory_order_relaxed)) {
+            std::uint32_t r = restarts.load(std::memory_order_acquire);
+            if (r != seenRestarts) {
+                seenRestarts = r;
+                seed = requestedSeed.load(std::memory_order_relaxed);
+                index = 0;
+                previous = groundSpec();
+            }
+            std::uint64_t head = writePos.load(std::memory_order_relaxed);
+            if (seenRestarts == 0 || head - readPos.load(std::memory_order_acquire) == TOWER_LOOKAHEAD) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+                continue;
+            }
+            TowerChunk& chunk = ring[head % TOWER_LOOKAHEAD];
+            {
+                PROFILE_SCOPE(Phase::Tower);
+                generateChunk(params, seed, index++, previous, chunk);
+            }
+            previous = chunk.platforms[TOWER_CHUNK_SIZE - 1];
+            writePos.store(head + 1, std::memory_order_release);
+        }
+    }
+};
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include "sim.h"
+#include <algorithm>
+#include <cmath>
+
+// Shares of the full internal resolution that dynamic resolution steps
+// between.
+const float MIN_RENDER_SHARE = 0.5f;
+const float RENDER_SHARE_STEP = 0.125f;
+
+// Dynamic resolution: picks the share of the internal resolution to draw at
+// from how long frames take. The time is measured on the CPU up to
+// display(), which blocks once the driver is a few frames behind, so a GPU
+// that cannot keep up shows there too. Over budget on average steps down
+// straight away; well under it for a whole second steps back up, and a
+// change waits half a second before the next so the share does not flap.
+class DynamicResolution {
+public:
+    void setBudget(float ms) { budgetMs = ms; }
+    float share() const { return current; }
+
+    // Back to the full share with no history, as after startup.
+    void reset() {
+        current = 1;
+        average = 0;
+        underBudget = 0;
+        cooldown = 0;
+    }
+
+    // Once per presented frame; true when the share changed.
+    bool addFrame(float workMs) {
+        average = average == 0 ? workMs : average + (workMs - average) * 0.1f;
+        if (cooldown > 0) {
+            cooldown--;
+            return false;
+        }
+        underBudget = average < budgetMs * 0.6f ? underBudget + 1 : 0;
+        float next = current;
+        if (average > budgetMs) next = std::max(MIN_RENDER_SHARE, current - RENDER_SHARE_STEP);
+        else if (underBudget >= 60) next = std::min(1.0f, current + RENDER_SHARE_STEP);
+        if (next == current) return false;
+        current = next;
+        average = 0;
+        underBudget = 0;
+        cooldown = 30;
+        return true;
+    }
+
+private:
+    float budgetMs = 1000.0f / 60;
+    float current = 1;
+    float average = 0;
+    int underBudget = 0;
+    int cooldown = 0;
+};
+
+// The scene is drawn into an offscreen texture at the logical WIDTH x HEIGHT
+// times a whole render scale, then stretched onto the window with nearest
+// filtering and letterboxed: by the largest whole factor that fits when
+// integer scaling is on, so pixels stay square, or as large as fits when it
+// is off. Views keep logical coordinates; a smaller share only narrows
+// their viewport to the top-left of the texture, so it never reallocates.
+class UpscaledTarget {
+public:
+    bool create(unsigned scale) {
+        if (!texture.create(WIDTH * scale, HEIGHT * scale)) return false;
+        texture.setSmooth(false);
+        sprite.setTexture(texture.getTexture(), true);
+        setShare(1);
+        return true;
+    }
+
+    sf::RenderTarget& target() { return texture; }
+    sf::Vector2u size() const { return texture.getSize(); }
+
+    void setShare(float share) {
+        sf::Vector2u size = texture.getSize();
+        int width = std::max(1, static_cast<int>(std::lround(size.x * share)));
+        int height = std::max(1, static_cast<int>(std::lround(size.y * share)));
+        viewport = sf::FloatRect(0, 0, static_cast<float>(width) / size.x, static_cast<float>(height) / size.y);
+        sprite.setTextureRect(sf::IntRect(0, 0, width, height));
+    }
+
+    // Points a logical-coordinate view at the part of the texture drawn this frame.
+    void fit(sf::View& view) const { view.setViewport(viewport); }
+
+    void display() { texture.display(); }
+
+    // Finishes the texture and draws it into the window; the window's view is
+    // rebuilt from its size every time, so resizing needs no event handling.
+    void present(sf::RenderWindow& window, bool integer) {
+        display();
+        sf::Vector2u size = window.getSize();
+        // The factor is per texel of the area drawn this frame, so integer
+        // scaling stays whole at any render scale or share.
+        sf::IntRect area = sprite.getTextureRect();
+        float factor = std::min(static_cast<float>(size.x) / area.width, static_cast<float>(size.y) / area.height);
+        if (integer && factor >= 1) factor = std::floor(factor);
+        sprite.setScale(factor, factor);
+        sprite.setPosition(std::floor((size.x - factor * area.width) / 2), std::floor((size.y - factor * area.height) / 2));
+        windowView.reset(sf::FloatRect(0, 0, static_cast<float>(size.x), static_cast<float>(size.y)));
+        window.setView(windowView);
+        window.clear();
+        window.draw(sprite);
+    }
+
+private:
+    sf::RenderTexture texture;
+    sf::Sprite sprite;
+    sf::View windowView;
+    sf::FloatRect viewport;
+};
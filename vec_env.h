@@ -0,0 +1,400 @@
+#pragma once
+
+#include "sim.h"
+#include "simd.h"
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// N games stepped together for training bots: reset(seed), then
+// step(actions) fills observations(), rewards() and dones(). Player and
+// platform state is stored as structure-of-arrays, one float per game, and
+// the hot phases (input, gravity integration, wall bounce, landing test,
+// camera) run as SIMD kernels over blocks of four games. Games that end are
+// reset in place, so the observation of a done game is already the first one
+// of its next episode.
+//
+// The rules are Simulation's classic ones, evaluated in the same order with
+// the same float expressions: with the same seed and inputs a game here is
+// bit-identical to a Simulation run. Bursts and highestY are not tracked,
+// and platform kinds and pickups from the params are dropped.
+class VecEnv {
+public:
+    // Games are processed in blocks of this many; storage is padded to it.
+    static const int LANES = 4;
+    // Platforms at or above the player's feet included in an observation,
+    // nearest first; the one being stood on counts.
+    static const int OBS_PLATFORMS = 4;
+    // Player x, screen y, vx, vy, canJump, canDoubleJump, then dx, dy per platform.
+    static const int OBS_SIZE = 6 + 2 * OBS_PLATFORMS;
+
+    SimParams params;
+    // A game is also done after this many ticks; 0 means only on death.
+    std::uint64_t maxTicks = 0;
+
+    // Per-game player state, indexed by game.
+    std::vector<float> posX, posY, velX, velY, lastWallY;
+    std::vector<std::int32_t> canJump, canDoubleJump, isWallJumping, facingRight;
+    std::vector<float> cameraY, scrollSpeed;
+    // Set when the player left the screen during the last step.
+    std::vector<std::int32_t> offScreen;
+    std::vector<std::int32_t> score;
+    std::vector<std::uint64_t> ticks;
+
+    // Platforms, indexed by platIndex(game, slot). Each game's slots form a
+    // ring ordered bottom to top from platformHead, as in Simulation.
+    std::vector<float> platX, platY, platWidth;
+    std::vector<std::int32_t> platScored;
+    std::vector<std::int32_t> platformHead;
+
+    VecEnv(int count, const SimParams& p = SimParams(), int tickRate = TICK_RATE)
+        : params(p.classic()), count(count), stride((count + LANES - 1) / LANES * LANES),
+          platforms(p.platformCount), deltaTime(1.0f / tickRate) {
+        for (auto* v : {&posX, &posY, &velX, &velY, &lastWallY, &cameraY, &scrollSpeed, &rewardBuf}) {
+            v->assign(stride, 0.0f);
+        }
+        for (auto* v : {&canJump, &canDoubleJump, &isWallJumping, &facingRight, &offScreen, &score, &platformHead}) {
+            v->assign(stride, 0);
+        }
+        ticks.assign(stride, 0);
+        platX.assign(static_cast<std::size_t>(platforms) * stride, 0.0f);
+        platY.assign(platX.size(), 0.0f);
+        platWidth.assign(platX.size(), 0.0f);
+        platScored.assign(platX.size(), 0);
+        input.assign(stride, 0);
+        lastInput.assign(stride, 0);
+        doneBuf.assign(stride, 0);
+        obsBuf.assign(static_cast<std::size_t>(stride) * OBS_SIZE, 0.0f);
+        towers.resize(stride);
+        reset(1);
+    }
+
+    int size() const { return count; }
+
+    // Blocked layout: the LANES games of a block keep their slots side by
+    // side, so a block's whole tower is one contiguous run per array.
+    std::size_t platIndex(int e, int slot) const {
+        return (static_cast<std::size_t>(e / LANES) * platforms + slot) * LANES + e % LANES;
+    }
+
+    // Game i starts from seed + i; later episodes take the following seeds.
+    void reset(std::uint64_t seed) {
+        nextSeed = seed;
+        for (int e = 0; e < stride; e++) resetGame(e, e < count ? nextSeed++ : 0);
+        for (int e = 0; e < count; e++) {
+            doneBuf[e] = 0;
+            rewardBuf[e] = 0;
+        }
+        for (int base = 0; base < stride; base += LANES) observe(base);
+    }
+
+    // actions holds one InputBits mask per game.
+    void step(const std::uint8_t* actions) {
+        for (int e = 0; e < count; e++) input[e] = actions[e];
+        for (int base = 0; base < stride; base += LANES) {
+            stepInput(base);
+            stepPlayer(base);
+            stepLanding(base);
+            stepCamera(base);
+        }
+        // Padding games are stepped with no input and only kept from falling
+        // forever; they never consume seeds.
+        for (int e = 0; e < stride; e++) {
+            recycle(e);
+            ticks[e]++;
+            bool dead = offScreen[e] != 0;
+            bool done = dead || (maxTicks != 0 && ticks[e] >= maxTicks);
+            if (e >= count) {
+                if (done) resetGame(e, 0);
+                continue;
+            }
+            doneBuf[e] = done;
+            if (done) resetGame(e, nextSeed++);
+        }
+        for (int base = 0; base < stride; base += LANES) observe(base);
+    }
+
+    // count * OBS_SIZE floats, game-major.
+    const float* observations() const { return obsBuf.data(); }
+    // Points scored this step (10 per new platform).
+    const float* rewards() const { return rewardBuf.data(); }
+    const std::uint8_t* dones() const { return doneBuf.data(); }
+
+private:
+    int count;
+    int stride;
+    int platforms;
+    float deltaTime;
+    std::uint64_t nextSeed = 1;
+    std::vector<TowerFeed> towers;
+    std::vector<std::uint8_t> input, lastInput;
+    std::vector<float> rewardBuf;
+    std::vector<std::uint8_t> doneBuf;
+    std::vector<float> obsBuf;
+    // Where and how fast the current block's players started the tick, for
+    // the landing sweep and the camera.
+    float fromX[LANES], fromY[LANES], fromVelY[LANES];
+
+    // Simulation::reset for one game.
+    void resetGame(int e, std::uint64_t seed) {
+        towers[e].reset(seed);
+        posX[e] = WIDTH / 2.0f;
+        posY[e] = HEIGHT - 100.0f;
+        velX[e] = velY[e] = lastWallY[e] = 0;
+        canJump[e] = 1;
+        canDoubleJump[e] = 0;
+        isWallJumping[e] = 0;
+        facingRight[e] = 1;
+        cameraY[e] = scrollSpeed[e] = 0;
+        offScreen[e] = 0;
+        score[e] = 0;
+        ticks[e] = 0;
+        lastInput[e] = 0;
+        platformHead[e] = 0;
+
+        PlatformSpec ground = groundSpec();
+        std::size_t g = platIndex(e, 0);
+        platX[g] = ground.x;
+        platY[g] = ground.y;
+        platWidth[g] = ground.width;
+        platScored[g] = 1;
+        for (int i = 0; i < platforms - 1; i++) {
+            PlatformSpec spec = towers[e].next(params);
+            std::size_t p = platIndex(e, i + 1);
+            platX[p] = spec.x;
+            platY[p] = spec.y;
+            platWidth[p] = spec.width;
+            platScored[p] = 0;
+        }
+    }
+
+    // One block of LANES games at a time, in vector registers. Conditions
+    // are lane masks and every branch of the scalar code becomes a select.
+    void stepInput(int base) {
+        const std::uint8_t* in = &input[base];
+        std::uint8_t* last = &lastInput[base];
+        const I4 bits = {in[0], in[1], in[2], in[3]};
+        const I4 lastBits = {last[0], last[1], last[2], last[3]};
+        for (int i = 0; i < LANES; i++) last[i] = in[i];
+        const I4 left = (bits & std::int32_t(INPUT_LEFT)) != 0;
+        const I4 right = (bits & std::int32_t(INPUT_RIGHT)) != 0;
+        const I4 jump = ((bits & std::int32_t(INPUT_JUMP_PRESSED)) |
+                         (bits & ~lastBits & std::int32_t(INPUT_JUMP))) != 0;
+        const F4 x = loadF4(&posX[base]), y = loadF4(&posY[base]);
+        F4 vy = loadF4(&velY[base]), wallY = loadF4(&lastWallY[base]);
+        I4 cj = loadI4(&canJump[base]) != 0;
+        I4 cdj = loadI4(&canDoubleJump[base]) != 0;
+        I4 wall = loadI4(&isWallJumping[base]) != 0;
+        const F4 maxSpeed = splat(params.maxSpeed), zero = splat(0.0f);
+
+        // handleInput.
+        F4 vx = select(right, maxSpeed, select(left, -maxSpeed, zero));
+        const I4 firstJump = jump & cj;
+        const I4 doubleJump = jump & ~cj & cdj;
+        vy = select(firstJump, splat(params.jumpForce), select(doubleJump, splat(params.doubleJumpForce), vy));
+        cdj = (cdj | firstJump) & ~doubleJump;
+        cj = cj & ~firstJump;
+
+        // checkWallJump.
+        const I4 airborne = jump & ~cj;
+        const I4 leftWall = airborne & (x <= 0.0f);
+        const I4 rightWall = airborne & ~leftWall & (x >= WIDTH - PLAYER_SIZE);
+        const I4 wallJump = leftWall | rightWall;
+        const I4 release = ~wallJump & wall & (absF4(y - wallY) > 50.0f);
+        vy = select(wallJump, splat(params.wallJumpForce), vy);
+        vx = select(leftWall, maxSpeed, select(rightWall, -maxSpeed, vx));
+        vx = select(release, select(left, -maxSpeed, select(right, maxSpeed, zero)), vx);
+        wall = (wall | wallJump) & ~release;
+        wallY = select(wallJump, y, wallY);
+
+        storeF4(&velX[base], vx);
+        storeF4(&velY[base], vy);
+        storeF4(&lastWallY[base], wallY);
+        storeI4(&canJump[base], cj & 1);
+        storeI4(&canDoubleJump[base], cdj & 1);
+        storeI4(&isWallJumping[base], wall & 1);
+    }
+
+    // updatePlayer and handleWallCollision.
+    void stepPlayer(int base) {
+        const float steps = deltaTime * 60.0f;
+        const float pull = params.gravity * steps;
+        F4 vx = loadF4(&velX[base]);
+        const F4 vy0 = loadF4(&velY[base]);
+        std::memcpy(fromX, &posX[base], sizeof(fromX));
+        std::memcpy(fromY, &posY[base], sizeof(fromY));
+        storeF4(fromVelY, vy0);
+        F4 x = loadF4(fromX) + vx * steps;
+        const F4 y = loadF4(fromY) + (vy0 + 0.5f * pull) * steps;
+        const F4 vy = vy0 + pull;
+        I4 facing = loadI4(&facingRight[base]);
+        facing = select(vx > 0.0f, splat(1), select(vx < 0.0f, splat(0), facing));
+
+        const I4 hitLeft = x <= 0.0f;
+        const I4 hitRight = ~hitLeft & (x >= WIDTH - PLAYER_SIZE);
+        x = select(hitLeft, splat(0.0f), select(hitRight, splat(WIDTH - PLAYER_SIZE), x));
+        vx = select(hitLeft | hitRight, -vx * params.wallBounceDamping, vx);
+
+        storeF4(&posX[base], x);
+        storeF4(&posY[base], y);
+        storeF4(&velX[base], vx);
+        storeF4(&velY[base], vy);
+        storeI4(&facingRight[base], facing);
+    }
+
+    // handleCollisions' sweep: every slot is tested and, of the platforms
+    // the player was over while the falling feet were between a top and
+    // LANDING_BAND below it, the highest wins, as it does in Simulation.
+    void stepLanding(int base) {
+        const F4 x = loadF4(&posX[base]), x0 = loadF4(fromX);
+        F4 y = loadF4(&posY[base]), vy = loadF4(&velY[base]);
+        const float steps = deltaTime * 60.0f;
+        const F4 a = loadF4(fromVelY) * steps;
+        const float b = 0.5f * params.gravity * steps * steps;
+        const F4 feet = y + PLAYER_SIZE;
+        const F4 fromFeet = loadF4(fromY) + PLAYER_SIZE;
+        // Lanes that start out falling take no apex; their quotient is dropped.
+        const F4 apex = select(a < 0.0f, minF4(-a / (2 * b), splat(1.0f)), splat(0.0f));
+        const F4 fallFeet = fromFeet + (a + b * apex) * apex;
+        const F4 bandTop = fallFeet - LANDING_BAND;
+        const I4 falling = vy > 0.0f;
+        for (int i = 0; i < LANES; i++) rewardBuf[base + i] = 0;
+        if (!anyLane(falling)) return;
+        I4 slotHit = splat(-1);
+        F4 bestTop = splat(0.0f), bestEnter = splat(0.0f);
+        for (int slot = 0; slot < platforms; slot++) {
+            const std::size_t row = platIndex(base, slot);
+            const F4 px = loadF4(&platX[row]);
+            const F4 top = loadF4(&platY[row]);
+            const F4 pw = loadF4(&platWidth[row]);
+            const I4 inBand = falling & (top >= bandTop) & (top < feet);
+            if (!anyLane(inBand)) continue;
+            const F4 enter = select(top <= fallFeet, apex, fallShareF4(a, b, top - fromFeet));
+            const F4 leave = select(top + LANDING_BAND >= feet, splat(1.0f),
+                                    fallShareF4(a, b, top + LANDING_BAND - fromFeet));
+            const F4 enterX = x0 + (x - x0) * enter;
+            const F4 leaveX = x0 + (x - x0) * leave;
+            const F4 left = minF4(enterX, leaveX), right = maxF4(enterX, leaveX);
+            const I4 hit = inBand & (maxF4(left, px) < minF4(right + PLAYER_SIZE, px + pw));
+            const I4 better = hit & ((slotHit < 0) | (top < bestTop));
+            slotHit = select(better, splat(slot), slotHit);
+            bestTop = select(better, top, bestTop);
+            bestEnter = select(better, enter, bestEnter);
+        }
+        const I4 landed = slotHit >= 0;
+        vy = select(landed, splat(0.0f), vy);
+        y = select(landed, bestTop - PLAYER_SIZE, y);
+        storeF4(&velY[base], vy);
+        storeF4(&posY[base], y);
+        storeI4(&canJump[base], select(landed, splat(1), loadI4(&canJump[base])));
+        storeI4(&canDoubleJump[base], select(landed, splat(1), loadI4(&canDoubleJump[base])));
+
+        // Scoring scatters into the platform arrays and walking off is
+        // Simulation::walkOff as is; landings are rare enough for a plain loop.
+        for (int i = 0; i < LANES; i++) {
+            const int e = base + i;
+            if (slotHit[i] < 0) continue;
+            const std::size_t p = platIndex(e, slotHit[i]);
+            std::int32_t& scored = platScored[p];
+            if (!scored) {
+                scored = 1;
+                score[e] += 10;
+                rewardBuf[e] = 10;
+            }
+            float right = platX[p] + platWidth[p];
+            float dx = posX[e] - fromX[i];
+            float off;
+            if (posX[e] >= right) off = (right - fromX[i]) / dx;
+            else if (posX[e] + PLAYER_SIZE <= platX[p]) off = (platX[p] - PLAYER_SIZE - fromX[i]) / dx;
+            else continue;
+            float rest = (1 - std::min(std::max(off, bestEnter[i]), 1.0f)) * steps;
+            posY[e] += 0.5f * params.gravity * rest * rest;
+            velY[e] = params.gravity * rest;
+        }
+    }
+
+    // fallShare for four lanes; lanes whose branch divides by zero are dropped.
+    static F4 fallShareF4(F4 a, float b, F4 d) {
+        const F4 root = sqrtF4(maxF4(a * a + 4 * b * d, splat(0.0f)));
+        const F4 s = select(a >= 0.0f, 2 * d / (a + root), (root - a) / (2 * b));
+        return minF4(maxF4(s, splat(0.0f)), splat(1.0f));
+    }
+
+    // updateCamera: the scroll eases in the same slices, following the
+    // player along the step, and a lane that leaves the screen in any of
+    // them is marked off screen. Recycling is per game in recycle().
+    void stepCamera(int base) {
+        const int slices = cameraSlices(deltaTime);
+        const float slice = deltaTime / slices;
+        const F4 y = loadF4(&posY[base]), y0 = loadF4(fromY);
+        F4 camera = loadF4(&cameraY[base]), scroll = loadF4(&scrollSpeed[base]);
+        I4 off = splat(0);
+        for (int i = 1; i <= slices; i++) {
+            const F4 top = i == slices ? y : y0 + (y - y0) * static_cast<float>(i) / static_cast<float>(slices);
+            F4 targetScroll = (top - camera) - static_cast<float>(HEIGHT / 2);
+            targetScroll = select(targetScroll > 0.0f, splat(0.0f), targetScroll);
+            scroll += (targetScroll - scroll) * 5.0f * slice;
+            camera += scroll * slice * 60.0f;
+            off |= (top - camera) > static_cast<float>(HEIGHT);
+        }
+        storeF4(&scrollSpeed[base], scroll);
+        storeF4(&cameraY[base], camera);
+        storeI4(&offScreen[base], off & 1);
+    }
+
+    // Array index of game e's k-th platform from the bottom (k < platforms).
+    std::size_t ring(int e, int k) const {
+        int slot = platformHead[e] + k;
+        if (slot >= platforms) slot -= platforms;
+        return platIndex(e, slot);
+    }
+
+    // Moves platforms that fell far enough below the screen to the top of
+    // the tower, generated inline.
+    void recycle(int e) {
+        std::size_t bottom;
+        while (platY[bottom = ring(e, 0)] - cameraY[e] > HEIGHT + PLAYER_SIZE) {
+            PlatformSpec spec = towers[e].next(params);
+            platX[bottom] = spec.x;
+            platY[bottom] = spec.y;
+            platWidth[bottom] = spec.width;
+            platScored[bottom] = 0;
+            platformHead[e] = platformHead[e] + 1 == platforms ? 0 : platformHead[e] + 1;
+        }
+    }
+
+    // Observations for one block. Walking a game's ring from the bottom,
+    // the platforms above the feet start after the ones below them, so a
+    // vector count over the slots replaces a per-game binary search.
+    void observe(int base) {
+        const F4 feet = loadF4(&posY[base]) + PLAYER_SIZE;
+        I4 below = splat(0);
+        for (int slot = 0; slot < platforms; slot++) {
+            below -= loadF4(&platY[platIndex(base, slot)]) > feet;
+        }
+        const float invWidth = 1.0f / WIDTH, invHeight = 1.0f / HEIGHT;
+        const float invSpeed = 1.0f / params.maxSpeed, invJump = 1.0f / std::abs(params.jumpForce);
+        for (int i = 0; i < LANES && base + i < count; i++) {
+            const int e = base + i;
+            float* obs = &obsBuf[static_cast<std::size_t>(e) * OBS_SIZE];
+            obs[0] = posX[e] * invWidth;
+            obs[1] = (posY[e] - cameraY[e]) * invHeight;
+            obs[2] = velX[e] * invSpeed;
+            obs[3] = velY[e] * invJump;
+            obs[4] = static_cast<float>(canJump[e]);
+            obs[5] = static_cast<float>(canDoubleJump[e]);
+            const float centerX = posX[e] + PLAYER_SIZE / 2;
+            for (int k = 0; k < OBS_PLATFORMS; k++) {
+                float dx = 0, dy = 0;
+                if (below[i] + k < platforms) {
+                    std::size_t p = ring(e, below[i] + k);
+                    dx = (platX[p] + platWidth[p] / 2 - centerX) * invWidth;
+                    dy = (platY[p] - feet[i]) * invHeight;
+                }
+                obs[6 + 2 * k] = dx;
+                obs[7 + 2 * k] = dy;
+            }
+        }
+    }
+};